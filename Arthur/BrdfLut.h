@@ -0,0 +1,208 @@
+#pragma once
+
+#ifndef BRDFLUT_H
+#define BRDFLUT_H
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Split-sum BRDF integration lookup table.
+// The table only depends on the BRDF, not on the environment, so it is generated once
+// offline by the BrdfLutGen tool and uploaded at startup instead of being rendered by pbrInit().
+//
+// File layout (little endian):
+//   char[4]  magic "BLUT"
+//   uint32   version
+//   uint32   width (NdotV axis), height (roughness axis), channels (2 or 3)
+//   uint16   width * height * channels half floats, row by row
+//
+// Channels are the scale (x) and bias (y) applied to F0, and optionally the average
+// directional albedo Eavg(roughness) (z) used for multiple-scattering energy compensation.
+class BrdfLut
+{
+public:
+    uint32_t width, height, channels;
+    std::vector<uint16_t> texels;
+
+    BrdfLut() : width(0), height(0), channels(0)
+    {
+
+    }
+
+    // Integrates the BRDF for every texel; same integral as the learnopengl brdf shader
+    void generate(uint32_t size, bool multiScatter, uint32_t sampleCount = 1024)
+    {
+        this->width = size;
+        this->height = size;
+        this->channels = multiScatter ? 3 : 2;
+        this->texels.assign(size * size * this->channels, 0);
+
+        std::vector<float> row(size * 2);
+        for (uint32_t y = 0; y < size; ++y)
+        {
+            float roughness = (y + 0.5f) / size;
+
+            // Eavg = 2 * integral of E(NdotV) * NdotV over NdotV
+            float averageAlbedo = 0.0f;
+            for (uint32_t x = 0; x < size; ++x)
+            {
+                float NdotV = (x + 0.5f) / size;
+                integrateBRDF(NdotV, roughness, sampleCount, row[x * 2], row[x * 2 + 1]);
+                averageAlbedo += (row[x * 2] + row[x * 2 + 1]) * NdotV;
+            }
+            averageAlbedo = 2.0f * averageAlbedo / size;
+
+            for (uint32_t x = 0; x < size; ++x)
+            {
+                uint16_t* texel = &this->texels[(y * size + x) * this->channels];
+                texel[0] = floatToHalf(row[x * 2]);
+                texel[1] = floatToHalf(row[x * 2 + 1]);
+                if (multiScatter)
+                    texel[2] = floatToHalf(averageAlbedo);
+            }
+        }
+    }
+
+    bool read(const std::string& path)
+    {
+        std::ifstream file(path.c_str(), std::ios::binary);
+        char magic[4];
+        uint32_t header[4];
+        if (!file.read(magic, 4) || std::memcmp(magic, "BLUT", 4) != 0 || !file.read((char*)header, sizeof(header)))
+        {
+            std::cerr << "BRDF LUT - FAILED LOADING : " << path << std::endl;
+            return false;
+        }
+        if (header[0] != VERSION || (header[3] != 2 && header[3] != 3))
+        {
+            std::cerr << "BRDF LUT - UNSUPPORTED FILE : " << path << std::endl;
+            return false;
+        }
+        this->width = header[1];
+        this->height = header[2];
+        this->channels = header[3];
+        this->texels.resize(this->width * this->height * this->channels);
+        if (!file.read((char*)&this->texels[0], this->texels.size() * sizeof(uint16_t)))
+        {
+            std::cerr << "BRDF LUT - TRUNCATED FILE : " << path << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    bool write(const std::string& path) const
+    {
+        std::ofstream file(path.c_str(), std::ios::binary);
+        uint32_t header[4] = { VERSION, this->width, this->height, this->channels };
+        file.write("BLUT", 4);
+        file.write((const char*)header, sizeof(header));
+        file.write((const char*)&this->texels[0], this->texels.size() * sizeof(uint16_t));
+        return file.good();
+    }
+
+    // IEEE 754 binary16 conversion with round to nearest even, as uploaded with GL_HALF_FLOAT
+    static uint16_t floatToHalf(float value)
+    {
+        uint32_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        uint32_t sign = (bits >> 16) & 0x8000;
+        int32_t exponent = (int32_t)((bits >> 23) & 0xFF) - 127 + 15;
+        uint32_t mantissa = bits & 0x7FFFFF;
+
+        if (exponent <= 0)
+        {
+            // subnormal or zero
+            if (exponent < -10)
+                return (uint16_t)sign;
+            mantissa |= 0x800000;
+            uint32_t shift = 14 - exponent;
+            uint32_t half = mantissa >> shift;
+            uint32_t rest = mantissa & ((1u << shift) - 1);
+            uint32_t halfway = 1u << (shift - 1);
+            if (rest > halfway || (rest == halfway && (half & 1)))
+                ++half;
+            return (uint16_t)(sign | half);
+        }
+        if (exponent >= 31)
+            return (uint16_t)(sign | 0x7C00);
+
+        uint32_t half = sign | (exponent << 10) | (mantissa >> 13);
+        uint32_t rest = mantissa & 0x1FFF;
+        if (rest > 0x1000 || (rest == 0x1000 && (half & 1)))
+            ++half;
+        return (uint16_t)half;
+    }
+
+private:
+    static const uint32_t VERSION = 1;
+
+    // http://holger.dammertz.org/stuff/notes_HammersleyOnHemisphere.html
+    static float radicalInverseVdC(uint32_t bits)
+    {
+        bits = (bits << 16u) | (bits >> 16u);
+        bits = ((bits & 0x55555555u) << 1u) | ((bits & 0xAAAAAAAAu) >> 1u);
+        bits = ((bits & 0x33333333u) << 2u) | ((bits & 0xCCCCCCCCu) >> 2u);
+        bits = ((bits & 0x0F0F0F0Fu) << 4u) | ((bits & 0xF0F0F0F0u) >> 4u);
+        bits = ((bits & 0x00FF00FFu) << 8u) | ((bits & 0xFF00FF00u) >> 8u);
+        return float(bits) * 2.3283064365386963e-10f; // / 0x100000000
+    }
+
+    // Smith-Schlick geometry term with the IBL remapping k = a^2 / 2
+    static float geometrySchlickGGX(float NdotV, float roughness)
+    {
+        float k = (roughness * roughness) / 2.0f;
+        return NdotV / (NdotV * (1.0f - k) + k);
+    }
+
+    static void integrateBRDF(float NdotV, float roughness, uint32_t sampleCount, float& scale, float& bias)
+    {
+        const float PI = 3.14159265359f;
+
+        // view vector in tangent space, normal is +Z
+        float Vx = std::sqrt(1.0f - NdotV * NdotV);
+        float Vz = NdotV;
+        float a = roughness * roughness;
+
+        float A = 0.0f;
+        float B = 0.0f;
+        for (uint32_t i = 0; i < sampleCount; ++i)
+        {
+            // importance sample the GGX lobe around the normal
+            float Xi1 = float(i) / float(sampleCount);
+            float Xi2 = radicalInverseVdC(i);
+            float phi = 2.0f * PI * Xi1;
+            float cosTheta = std::sqrt((1.0f - Xi2) / (1.0f + (a * a - 1.0f) * Xi2));
+            float sinTheta = std::sqrt(1.0f - cosTheta * cosTheta);
+            // the shader's tangent frame for N = +Z maps the sample's y component to x
+            float Hx = std::sin(phi) * sinTheta;
+            float Hz = cosTheta;
+
+            // L = reflect(-V, H), V has no y component so only x and z of H are needed
+            float VdotH = Vx * Hx + Vz * Hz;
+            float Lz = 2.0f * VdotH * Hz - Vz;
+
+            float NdotL = Lz > 0.0f ? Lz : 0.0f;
+            float NdotH = Hz > 0.0f ? Hz : 0.0f;
+            VdotH = VdotH > 0.0f ? VdotH : 0.0f;
+
+            if (NdotL > 0.0f)
+            {
+                float G = geometrySchlickGGX(NdotV, roughness) * geometrySchlickGGX(NdotL, roughness);
+                float G_Vis = (G * VdotH) / (NdotH * NdotV);
+                float Fc = std::pow(1.0f - VdotH, 5.0f);
+
+                A += (1.0f - Fc) * G_Vis;
+                B += Fc * G_Vis;
+            }
+        }
+        scale = A / float(sampleCount);
+        bias = B / float(sampleCount);
+    }
+};
+
+#endif // !BRDFLUT_H
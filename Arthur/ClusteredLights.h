@@ -0,0 +1,256 @@
+#pragma once
+
+#ifndef CLUSTEREDLIGHTS_H
+#define CLUSTEREDLIGHTS_H
+
+//for openGL headers
+#include <GL/glew.h>
+
+#include <cmath>
+#include <vector>
+
+// GLM Mathemtics Header
+#include <glm/glm.hpp>
+
+#include "Shader.h"
+#include "GLResource.h"
+#include "GLState.h"
+
+// Point light of the clustered lighting, its contribution fades to zero at its radius
+struct PointLight
+{
+    glm::vec3 position;
+    float radius;
+    glm::vec3 color;
+};
+
+// Point lights assigned to a froxel grid: GRID_X x GRID_Y screen tiles by GRID_Z view depth slices, exponentially
+// spaced between the near and far planes. GL 3.3 has neither compute shaders nor storage buffers, so the lights are
+// assigned on the CPU each frame and the lists reach the shaders through texture buffers:
+//   clusterGrid         RG32UI, per cluster the offset and count of its list in clusterLightIndices
+//   clusterLightIndices R32UI, the lists end to end
+//   clusterLightData    RGBA32F, two texels per light: view space position and radius, color
+// shaders/include/clustered_lights.glsl reads them; a fragment only shades the lights of its cluster.
+class ClusteredLights
+{
+public:
+    // Grid dimensions, sent to the shaders as uniforms by bind()
+    static const GLuint GRID_X = 16;
+    static const GLuint GRID_Y = 9;
+    static const GLuint GRID_Z = 24;
+    static const GLuint CLUSTERS = GRID_X * GRID_Y * GRID_Z;
+
+    // World space lights, assigned by update()
+    std::vector<PointLight> lights;
+    bool enabled;
+
+    ClusteredLights() : enabled(true), indexCapacity(0), lightCapacity(0), indexCount(0), maxCount(0),
+        width(1), height(1), nearPlane(0.1f), farPlane(100.0f)
+    {
+
+    }
+
+    void init()
+    {
+        createTextureBuffer(this->gridBuffer, this->gridTexture, "clusterGrid", GL_RG32UI);
+        glBindBuffer(GL_TEXTURE_BUFFER, this->gridBuffer);
+        glBufferData(GL_TEXTURE_BUFFER, CLUSTERS * 2 * sizeof(GLuint), nullptr, GL_STREAM_DRAW);
+        this->gridBuffer.setMemory(CLUSTERS * 2 * sizeof(GLuint));
+        createTextureBuffer(this->indexBuffer, this->indexTexture, "clusterLightIndices", GL_R32UI);
+        createTextureBuffer(this->lightBuffer, this->lightTexture, "clusterLightData", GL_RGBA32F);
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+        this->grid.resize(CLUSTERS * 2);
+    }
+
+    // Assigns the lights to the clusters of a camera and uploads the lists; width and height are the size of the
+    // target the lights are shaded in, the tiles are a fraction of it
+    void update(const glm::mat4& view, const glm::mat4& projection, float nearPlane, float farPlane, GLsizei width, GLsizei height)
+    {
+        this->width = width;
+        this->height = height;
+        this->nearPlane = nearPlane;
+        this->farPlane = farPlane;
+
+        const GLuint lightCount = (GLuint)this->lights.size();
+        this->lightData.resize(lightCount * 2);
+        this->spans.clear();
+        for (GLuint i = 0; i < CLUSTERS; ++i)
+            this->grid[i * 2 + 1] = 0;
+
+        // view space lights, and the clusters overlapped by the box around each light's sphere
+        const float depthScale = GRID_Z / std::log(farPlane / nearPlane);
+        for (GLuint i = 0; i < lightCount; ++i)
+        {
+            const PointLight& light = this->lights[i];
+            glm::vec3 center = glm::vec3(view * glm::vec4(light.position, 1.0f));
+            this->lightData[i * 2] = glm::vec4(center, light.radius);
+            this->lightData[i * 2 + 1] = glm::vec4(light.color, 0.0f);
+
+            float nearest = -center.z - light.radius, farthest = -center.z + light.radius;
+            if (farthest <= nearPlane || nearest >= farPlane)
+                continue;
+            nearest = nearest > nearPlane ? nearest : nearPlane;
+            farthest = farthest < farPlane ? farthest : farPlane;
+            int firstSlice = clampIndex((int)std::floor(std::log(nearest / nearPlane) * depthScale), GRID_Z);
+            int lastSlice = clampIndex((int)std::floor(std::log(farthest / nearPlane) * depthScale), GRID_Z);
+            for (int slice = firstSlice; slice <= lastSlice; ++slice)
+            {
+                // the box's projection within the slice is bounded by its corners at the slice's two depths
+                float sliceNear = nearPlane * std::exp(slice / depthScale), sliceFar = nearPlane * std::exp((slice + 1) / depthScale);
+                float depths[2] = { nearest > sliceNear ? nearest : sliceNear, farthest < sliceFar ? farthest : sliceFar };
+                glm::vec2 low(1.0f), high(-1.0f);
+                for (int d = 0; d < 2; ++d)
+                {
+                    for (int corner = 0; corner < 4; ++corner)
+                    {
+                        glm::vec2 offset((corner & 1) ? light.radius : -light.radius, (corner & 2) ? light.radius : -light.radius);
+                        glm::vec2 ndc(projection[0][0] * (center.x + offset.x) / depths[d], projection[1][1] * (center.y + offset.y) / depths[d]);
+                        low = glm::vec2(ndc.x < low.x ? ndc.x : low.x, ndc.y < low.y ? ndc.y : low.y);
+                        high = glm::vec2(ndc.x > high.x ? ndc.x : high.x, ndc.y > high.y ? ndc.y : high.y);
+                    }
+                }
+                if (low.x > 1.0f || low.y > 1.0f || high.x < -1.0f || high.y < -1.0f)
+                    continue;
+
+                Span span;
+                span.light = i;
+                span.slice = slice;
+                span.x0 = clampIndex((int)std::floor((low.x * 0.5f + 0.5f) * GRID_X), GRID_X);
+                span.x1 = clampIndex((int)std::floor((high.x * 0.5f + 0.5f) * GRID_X), GRID_X);
+                span.y0 = clampIndex((int)std::floor((low.y * 0.5f + 0.5f) * GRID_Y), GRID_Y);
+                span.y1 = clampIndex((int)std::floor((high.y * 0.5f + 0.5f) * GRID_Y), GRID_Y);
+                this->spans.push_back(span);
+                for (int y = span.y0; y <= span.y1; ++y)
+                {
+                    for (int x = span.x0; x <= span.x1; ++x)
+                        ++this->grid[clusterIndex(x, y, slice) * 2 + 1];
+                }
+            }
+        }
+
+        // counts to offsets, then the lists filled in light order
+        this->indexCount = 0;
+        this->maxCount = 0;
+        for (GLuint i = 0; i < CLUSTERS; ++i)
+        {
+            this->grid[i * 2] = this->indexCount;
+            this->indexCount += this->grid[i * 2 + 1];
+            this->maxCount = this->grid[i * 2 + 1] > this->maxCount ? this->grid[i * 2 + 1] : this->maxCount;
+            this->grid[i * 2 + 1] = 0;
+        }
+        this->indices.resize(this->indexCount);
+        for (size_t i = 0; i < this->spans.size(); ++i)
+        {
+            const Span& span = this->spans[i];
+            for (int y = span.y0; y <= span.y1; ++y)
+            {
+                for (int x = span.x0; x <= span.x1; ++x)
+                {
+                    GLuint cluster = clusterIndex(x, y, span.slice);
+                    this->indices[this->grid[cluster * 2] + this->grid[cluster * 2 + 1]++] = span.light;
+                }
+            }
+        }
+
+        upload(this->gridBuffer, &this->grid[0], CLUSTERS * 2 * sizeof(GLuint), nullptr);
+        upload(this->indexBuffer, this->indices.empty() ? nullptr : &this->indices[0], this->indexCount * sizeof(GLuint), &this->indexCapacity);
+        upload(this->lightBuffer, this->lightData.empty() ? nullptr : &this->lightData[0], lightCount * 2 * sizeof(glm::vec4), &this->lightCapacity);
+    }
+
+    // Binds the three texture buffers from unit on and sets the grid's uniforms; no light is shaded when disabled
+    void bind(const Shader& shader, GLuint unit) const
+    {
+        const float depthScale = GRID_Z / std::log(this->farPlane / this->nearPlane);
+        shader.setInt("clusterLightCount", this->enabled ? (int)this->lights.size() : 0);
+        shader.setVec3("clusterDimensions", (float)GRID_X, (float)GRID_Y, (float)GRID_Z);
+        shader.setVec2("clusterTileScale", (float)GRID_X / this->width, (float)GRID_Y / this->height);
+        shader.setVec2("clusterDepthParams", depthScale, depthScale * std::log(this->nearPlane));
+
+        GLState::get().activeTexture(GL_TEXTURE0 + unit);
+        GLState::get().bindTexture(GL_TEXTURE_BUFFER, this->gridTexture);
+        GLState::get().activeTexture(GL_TEXTURE0 + unit + 1);
+        GLState::get().bindTexture(GL_TEXTURE_BUFFER, this->indexTexture);
+        GLState::get().activeTexture(GL_TEXTURE0 + unit + 2);
+        GLState::get().bindTexture(GL_TEXTURE_BUFFER, this->lightTexture);
+    }
+
+    // For shaders also drawn by passes the grid was not built for, such as the reflection probe captures
+    static void unbind(const Shader& shader)
+    {
+        shader.setInt("clusterLightCount", 0);
+    }
+
+    // Entries of the lists of the last update(), and the longest list
+    GLuint listEntries() const
+    {
+        return this->indexCount;
+    }
+    GLuint longestList() const
+    {
+        return this->maxCount;
+    }
+
+private:
+    // Tiles of one slice a light overlaps
+    struct Span
+    {
+        GLuint light;
+        int slice;
+        int x0, x1, y0, y1;
+    };
+
+    BufferHandle gridBuffer, indexBuffer, lightBuffer;
+    TextureHandle gridTexture, indexTexture, lightTexture;
+    GLsizeiptr indexCapacity, lightCapacity;
+    // kept across frames, update() allocates only when the lists outgrow them
+    std::vector<GLuint> grid;
+    std::vector<GLuint> indices;
+    std::vector<glm::vec4> lightData;
+    std::vector<Span> spans;
+    GLuint indexCount, maxCount;
+    GLsizei width, height;
+    float nearPlane, farPlane;
+
+    static int clampIndex(int index, GLuint count)
+    {
+        return index < 0 ? 0 : (index >= (int)count ? (int)count - 1 : index);
+    }
+
+    static GLuint clusterIndex(int x, int y, int slice)
+    {
+        return (slice * GRID_Y + y) * GRID_X + x;
+    }
+
+    static void createTextureBuffer(BufferHandle& buffer, TextureHandle& texture, const std::string& label, GLenum internalFormat)
+    {
+        buffer.create(label);
+        glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+        // a texture buffer needs a data store before it is sampled
+        glBufferData(GL_TEXTURE_BUFFER, 16, nullptr, GL_STREAM_DRAW);
+        buffer.setMemory(16);
+        texture.create(label);
+        GLState::get().bindTexture(GL_TEXTURE_BUFFER, texture);
+        glTexBuffer(GL_TEXTURE_BUFFER, internalFormat, buffer);
+    }
+
+    // Orphans the buffer's store so the upload never waits on the frames still reading it; capacity grows to fit
+    static void upload(BufferHandle& buffer, const void* data, GLsizeiptr bytes, GLsizeiptr* capacity)
+    {
+        glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+        GLsizeiptr size = capacity != nullptr ? *capacity : bytes;
+        if (capacity != nullptr && bytes > *capacity)
+        {
+            size = *capacity = bytes + bytes / 2;
+            buffer.setMemory(size);
+        }
+        if (size > 0)
+        {
+            glBufferData(GL_TEXTURE_BUFFER, size, nullptr, GL_STREAM_DRAW);
+            if (bytes > 0)
+                glBufferSubData(GL_TEXTURE_BUFFER, 0, bytes, data);
+        }
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    }
+};
+
+#endif // !CLUSTEREDLIGHTS_H
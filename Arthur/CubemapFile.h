@@ -0,0 +1,274 @@
+#pragma once
+
+#ifndef CUBEMAPFILE_H
+#define CUBEMAPFILE_H
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Storage formats of a cubemap container
+enum CubemapFormat {
+    CUBEMAP_RGB8 = 0,
+    CUBEMAP_BC1 = 1,   // S3TC DXT1, 8 bytes per 4x4 block
+    CUBEMAP_BC6H = 2   // BPTC unsigned float, 16 bytes per 4x4 block
+};
+
+// Single file holding the six faces of a cubemap and their mip chain, ready to be uploaded without decoding.
+// Written by the CubemapConvert tool from the images/<name>/{right,left,...}.jpg sets.
+//
+// File layout (little endian):
+//   char[4]  magic "CUBE"
+//   uint32   version
+//   uint32   format (CubemapFormat), face size of mip 0, mip levels
+//   bytes    for each mip level, for each face (+X, -X, +Y, -Y, +Z, -Z): the level's face data
+class CubemapFile
+{
+public:
+    uint32_t format, size, levels;
+    std::vector<uint8_t> data;
+
+    CubemapFile() : format(CUBEMAP_RGB8), size(0), levels(0)
+    {
+
+    }
+
+    static uint32_t levelSize(uint32_t size, uint32_t level)
+    {
+        uint32_t levelSize = size >> level;
+        return levelSize > 0 ? levelSize : 1;
+    }
+
+    static size_t faceBytes(uint32_t format, uint32_t size)
+    {
+        size_t blocks = (size_t)((size + 3) / 4) * ((size + 3) / 4);
+        switch (format)
+        {
+        case CUBEMAP_BC1:
+            return blocks * 8;
+        case CUBEMAP_BC6H:
+            return blocks * 16;
+        default:
+            return (size_t)size * size * 3;
+        }
+    }
+
+    // Offset of a face of a mip level in data
+    size_t offset(uint32_t level, uint32_t face) const
+    {
+        size_t bytes = 0;
+        for (uint32_t i = 0; i < level; ++i)
+            bytes += 6 * faceBytes(this->format, levelSize(this->size, i));
+        return bytes + face * faceBytes(this->format, levelSize(this->size, level));
+    }
+
+    // Builds an uncompressed container from six RGB8 faces, with a box filtered mip chain down to 1x1
+    void setFaces(uint32_t size, const unsigned char* const faces[6], bool mipmapped)
+    {
+        this->format = CUBEMAP_RGB8;
+        this->size = size;
+        this->levels = 1;
+        if (mipmapped)
+        {
+            while ((size >> this->levels) > 0)
+                ++this->levels;
+        }
+        this->data.resize(this->offset(this->levels, 0));
+
+        for (uint32_t face = 0; face < 6; ++face)
+            std::memcpy(&this->data[this->offset(0, face)], faces[face], faceBytes(CUBEMAP_RGB8, size));
+
+        for (uint32_t level = 1; level < this->levels; ++level)
+        {
+            uint32_t sourceSize = levelSize(size, level - 1);
+            uint32_t targetSize = levelSize(size, level);
+            for (uint32_t face = 0; face < 6; ++face)
+            {
+                const uint8_t* source = &this->data[this->offset(level - 1, face)];
+                uint8_t* target = &this->data[this->offset(level, face)];
+                for (uint32_t y = 0; y < targetSize; ++y)
+                {
+                    for (uint32_t x = 0; x < targetSize; ++x)
+                    {
+                        for (uint32_t c = 0; c < 3; ++c)
+                        {
+                            uint32_t x0 = x * 2, y0 = y * 2;
+                            uint32_t x1 = x0 + 1 < sourceSize ? x0 + 1 : x0;
+                            uint32_t y1 = y0 + 1 < sourceSize ? y0 + 1 : y0;
+                            uint32_t sum = source[(y0 * sourceSize + x0) * 3 + c] + source[(y0 * sourceSize + x1) * 3 + c]
+                                         + source[(y1 * sourceSize + x0) * 3 + c] + source[(y1 * sourceSize + x1) * 3 + c];
+                            target[(y * targetSize + x) * 3 + c] = (uint8_t)((sum + 2) / 4);
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    // Re-encodes an RGB8 container to BC1 (range fit of each 4x4 block), 6x smaller than RGB8
+    void compressBC1()
+    {
+        if (this->format != CUBEMAP_RGB8)
+            return;
+
+        std::vector<uint8_t> compressed;
+        for (uint32_t level = 0; level < this->levels; ++level)
+        {
+            uint32_t faceSize = levelSize(this->size, level);
+            for (uint32_t face = 0; face < 6; ++face)
+            {
+                const uint8_t* pixels = &this->data[this->offset(level, face)];
+                for (uint32_t by = 0; by < faceSize; by += 4)
+                {
+                    for (uint32_t bx = 0; bx < faceSize; bx += 4)
+                    {
+                        uint8_t block[16][3];
+                        for (uint32_t i = 0; i < 16; ++i)
+                        {
+                            // faces smaller than a block repeat their last row / column
+                            uint32_t x = bx + i % 4 < faceSize ? bx + i % 4 : faceSize - 1;
+                            uint32_t y = by + i / 4 < faceSize ? by + i / 4 : faceSize - 1;
+                            std::memcpy(block[i], &pixels[(y * faceSize + x) * 3], 3);
+                        }
+                        uint8_t encoded[8];
+                        encodeBC1Block(block, encoded);
+                        compressed.insert(compressed.end(), encoded, encoded + 8);
+                    }
+                }
+            }
+        }
+        this->format = CUBEMAP_BC1;
+        this->data.swap(compressed);
+    }
+
+    // Reads the whole container with a single read
+    bool read(const std::string& path)
+    {
+        std::ifstream file(path.c_str(), std::ios::binary | std::ios::ate);
+        if (!file)
+            return false;
+
+        std::vector<uint8_t> contents((size_t)file.tellg());
+        file.seekg(0);
+        const size_t headerBytes = 4 + 4 * sizeof(uint32_t);
+        if (contents.size() < headerBytes || !file.read((char*)&contents[0], contents.size()) || std::memcmp(&contents[0], "CUBE", 4) != 0)
+        {
+            std::cerr << "CUBEMAP - FAILED LOADING : " << path << std::endl;
+            return false;
+        }
+
+        uint32_t header[4];
+        std::memcpy(header, &contents[4], sizeof(header));
+        if (header[0] != VERSION || header[1] > CUBEMAP_BC6H || header[2] == 0 || header[3] == 0)
+        {
+            std::cerr << "CUBEMAP - UNSUPPORTED FILE : " << path << std::endl;
+            return false;
+        }
+        this->format = header[1];
+        this->size = header[2];
+        this->levels = header[3];
+        if (contents.size() - headerBytes < this->offset(this->levels, 0))
+        {
+            std::cerr << "CUBEMAP - TRUNCATED FILE : " << path << std::endl;
+            return false;
+        }
+        this->data.assign(contents.begin() + headerBytes, contents.begin() + headerBytes + this->offset(this->levels, 0));
+        return true;
+    }
+
+    bool write(const std::string& path) const
+    {
+        std::ofstream file(path.c_str(), std::ios::binary);
+        uint32_t header[4] = { VERSION, this->format, this->size, this->levels };
+        file.write("CUBE", 4);
+        file.write((const char*)header, sizeof(header));
+        file.write((const char*)&this->data[0], this->data.size());
+        return file.good();
+    }
+
+private:
+    static const uint32_t VERSION = 1;
+
+    static uint16_t toRGB565(const int color[3])
+    {
+        return (uint16_t)(((color[0] * 31 + 127) / 255) << 11 | ((color[1] * 63 + 127) / 255) << 5 | ((color[2] * 31 + 127) / 255));
+    }
+
+    static void fromRGB565(uint16_t packed, int color[3])
+    {
+        int r = (packed >> 11) & 31, g = (packed >> 5) & 63, b = packed & 31;
+        color[0] = (r << 3) | (r >> 2);
+        color[1] = (g << 2) | (g >> 4);
+        color[2] = (b << 3) | (b >> 2);
+    }
+
+    static void encodeBC1Block(const uint8_t block[16][3], uint8_t encoded[8])
+    {
+        // endpoints from the block's bounding box, inset by 1/16 of the range to reduce the error of the extremes
+        int minColor[3] = { 255, 255, 255 }, maxColor[3] = { 0, 0, 0 };
+        for (int i = 0; i < 16; ++i)
+        {
+            for (int c = 0; c < 3; ++c)
+            {
+                minColor[c] = block[i][c] < minColor[c] ? block[i][c] : minColor[c];
+                maxColor[c] = block[i][c] > maxColor[c] ? block[i][c] : maxColor[c];
+            }
+        }
+        for (int c = 0; c < 3; ++c)
+        {
+            int inset = (maxColor[c] - minColor[c]) / 16;
+            minColor[c] += inset;
+            maxColor[c] -= inset;
+        }
+
+        uint16_t color0 = toRGB565(maxColor);
+        uint16_t color1 = toRGB565(minColor);
+        uint32_t indices = 0;
+        if (color0 < color1)
+        {
+            uint16_t swap = color0;
+            color0 = color1;
+            color1 = swap;
+        }
+        if (color0 != color1)
+        {
+            // four color mode: color0, color1, 2/3 color0 + 1/3 color1, 1/3 color0 + 2/3 color1
+            int palette[4][3];
+            fromRGB565(color0, palette[0]);
+            fromRGB565(color1, palette[1]);
+            for (int c = 0; c < 3; ++c)
+            {
+                palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+                palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+            }
+            for (int i = 0; i < 16; ++i)
+            {
+                int best = 0, bestError = 0x7FFFFFFF;
+                for (int p = 0; p < 4; ++p)
+                {
+                    int error = 0;
+                    for (int c = 0; c < 3; ++c)
+                        error += (block[i][c] - palette[p][c]) * (block[i][c] - palette[p][c]);
+                    if (error < bestError)
+                    {
+                        bestError = error;
+                        best = p;
+                    }
+                }
+                indices |= (uint32_t)best << (i * 2);
+            }
+        }
+
+        encoded[0] = (uint8_t)(color0 & 0xFF);
+        encoded[1] = (uint8_t)(color0 >> 8);
+        encoded[2] = (uint8_t)(color1 & 0xFF);
+        encoded[3] = (uint8_t)(color1 >> 8);
+        for (int i = 0; i < 4; ++i)
+            encoded[4 + i] = (uint8_t)(indices >> (i * 8));
+    }
+};
+
+#endif // !CUBEMAPFILE_H
@@ -0,0 +1,129 @@
+#pragma once
+
+#ifndef DYNAMICRESOLUTION_H
+#define DYNAMICRESOLUTION_H
+
+//for openGL headers
+#include <GL/glew.h>
+
+#include <cmath>
+
+// Scale of the scene's render resolution, steered towards a GPU time budget. The scene's GPU time is measured
+// with GL_TIME_ELAPSED queries read back FRAME_LATENCY frames later, so measuring never waits on the GPU, and a
+// PID controller in incremental form turns the relative error into a scale change. The scale applied moves by whole SCALE_STEPS
+// only, so the pooled render targets are not reallocated every frame.
+class DynamicResolution
+{
+public:
+    // Frames in flight before a frame's query is read back
+    static const GLuint FRAME_LATENCY = 4;
+    // Scales are multiples of 1 / SCALE_STEPS
+    static const int SCALE_STEPS = 20;
+
+    bool enabled;
+    // GPU time budget of the scene in milliseconds
+    float targetMs;
+    // Bounds of the scale of each axis
+    float minScale, maxScale;
+
+    DynamicResolution() : enabled(false), targetMs(14.0f), minScale(0.5f), maxScale(1.0f), initialized(false), active(false),
+        frameIndex(0), current(1.0f), applied(1.0f), previousError(0.0f), olderError(0.0f), gpuMs(0.0f)
+    {
+        for (GLuint i = 0; i < FRAME_LATENCY; ++i)
+            this->issued[i] = false;
+    }
+
+    // Creates the queries, needs a GL context
+    void init()
+    {
+        glGenQueries(FRAME_LATENCY, this->queries);
+        this->initialized = true;
+    }
+
+    // Updates the scale from the frame measured FRAME_LATENCY frames ago, then starts measuring this one
+    void beginFrame()
+    {
+        if (!this->initialized)
+            return;
+        GLuint slot = this->frameIndex % FRAME_LATENCY;
+        if (this->issued[slot])
+        {
+            GLint available = GL_FALSE;
+            glGetQueryObjectiv(this->queries[slot], GL_QUERY_RESULT_AVAILABLE, &available);
+            if (available == GL_TRUE)
+            {
+                GLuint64 elapsed = 0;
+                glGetQueryObjectui64v(this->queries[slot], GL_QUERY_RESULT, &elapsed);
+                this->update((float)(elapsed / 1000000.0));
+            }
+        }
+        glBeginQuery(GL_TIME_ELAPSED, this->queries[slot]);
+        this->issued[slot] = true;
+        this->active = true;
+    }
+
+    void endFrame()
+    {
+        if (!this->active)
+            return;
+        glEndQuery(GL_TIME_ELAPSED);
+        this->active = false;
+        ++this->frameIndex;
+    }
+
+    // Scale of each axis of the scene's render targets, 1 when disabled
+    float scale() const
+    {
+        return this->enabled ? this->applied : 1.0f;
+    }
+
+    // Latest GPU time of the scene, in milliseconds
+    float gpuTime() const
+    {
+        return this->gpuMs;
+    }
+
+private:
+    bool initialized, active;
+    GLuint queries[FRAME_LATENCY];
+    bool issued[FRAME_LATENCY];
+    unsigned long long frameIndex;
+    // controller output, and the quantized scale actually rendered at
+    float current, applied;
+    // errors of the two previous updates
+    float previousError, olderError;
+    float gpuMs;
+
+    void update(float measuredMs)
+    {
+        this->gpuMs = measuredMs;
+        if (!this->enabled)
+        {
+            // starts again from full resolution when enabled
+            this->current = this->applied = this->maxScale;
+            this->previousError = this->olderError = 0.0f;
+            return;
+        }
+
+        // gains on the relative error, positive when there is time left: the scale grows. The scale itself is the
+        // controller's state, each update adds the change of the PID output: the P term on the error's change, the
+        // I term on the error, the D term on its second difference
+        const float KP = 0.05f, KI = 0.1f, KD = 0.02f;
+        float error = (this->targetMs - measuredMs) / this->targetMs;
+        float change = KP * (error - this->previousError) + KI * error + KD * (error - 2.0f * this->previousError + this->olderError);
+        this->olderError = this->previousError;
+        this->previousError = error;
+        // anti-windup: the state is the clamped scale, so nothing accumulates while it sits at a bound
+        this->current = std::fmin(std::fmax(this->current + change, this->minScale), this->maxScale);
+
+        // a whole step of hysteresis before the render targets change size
+        const float step = 1.0f / SCALE_STEPS;
+        if (std::fabs(this->current - this->applied) >= step || this->applied < this->minScale || this->applied > this->maxScale)
+        {
+            this->applied = std::round(this->current * SCALE_STEPS) / SCALE_STEPS;
+            this->applied = std::fmin(std::fmax(this->applied, this->minScale), this->maxScale);
+        }
+    }
+};
+
+#endif // !DYNAMICRESOLUTION_H
@@ -0,0 +1,214 @@
+#pragma once
+
+#ifndef ENVIRONMENT_H
+#define ENVIRONMENT_H
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <dirent.h>
+#endif
+
+// An image based lighting environment described by a sIBL .ibl descriptor.
+// The small EVfile is used for the diffuse irradiance bake, the large REFfile only for specular prefiltering.
+struct Environment
+{
+    std::string name;
+    std::string directory;
+    // Resolved paths of the environment (diffuse) and reflection (specular) maps
+    std::string evPath;
+    std::string refPath;
+    float evMulti, evGamma;
+    float refMulti, refGamma;
+
+    Environment() : evMulti(1.0f), evGamma(1.0f), refMulti(1.0f), refGamma(1.0f)
+    {
+
+    }
+};
+
+// Lists the environments found in the sub folders of an image directory, one .ibl descriptor per folder
+class EnvironmentRegistry
+{
+public:
+    std::vector<Environment> environments;
+
+    void scan(const std::string& root)
+    {
+        this->environments.clear();
+
+        std::vector<std::string> folders = listDirectory(root, true);
+        std::sort(folders.begin(), folders.end());
+        for (size_t i = 0; i < folders.size(); i++)
+        {
+            std::string directory = root + "/" + folders[i];
+            std::vector<std::string> files = listDirectory(directory, false);
+            for (size_t j = 0; j < files.size(); j++)
+            {
+                if (!hasSuffix(files[j], ".ibl"))
+                    continue;
+
+                Environment environment;
+                if (parseDescriptor(directory, directory + "/" + files[j], environment))
+                    this->environments.push_back(environment);
+                break;
+            }
+        }
+    }
+
+    // Returns the index of the environment with the given name, or -1
+    int find(const std::string& name) const
+    {
+        for (size_t i = 0; i < this->environments.size(); i++)
+        {
+            if (this->environments[i].name == name)
+                return (int)i;
+        }
+        return -1;
+    }
+
+    // Reads the keys of a sIBL descriptor; section names are ignored since the keys are unique
+    static bool parseDescriptor(const std::string& directory, const std::string& path, Environment& environment)
+    {
+        std::ifstream file(path.c_str());
+        if (!file)
+        {
+            std::cout << "ERROR::IBL::FILE_NOT_SUCCESSFULLY_READ " << path << std::endl;
+            return false;
+        }
+
+        std::string evFile, refFile;
+        std::string line;
+        while (std::getline(file, line))
+        {
+            size_t separator = line.find('=');
+            if (line.empty() || line[0] == '[' || separator == std::string::npos)
+                continue;
+
+            std::string key = trim(line.substr(0, separator));
+            std::string value = trim(line.substr(separator + 1));
+            if (value.size() >= 2 && value[0] == '"' && value[value.size() - 1] == '"')
+                value = value.substr(1, value.size() - 2);
+
+            if (key == "Name")
+                environment.name = value;
+            else if (key == "EVfile")
+                evFile = value;
+            else if (key == "EVmulti")
+                environment.evMulti = (float)std::atof(value.c_str());
+            else if (key == "EVgamma")
+                environment.evGamma = (float)std::atof(value.c_str());
+            else if (key == "REFfile")
+                refFile = value;
+            else if (key == "REFmulti")
+                environment.refMulti = (float)std::atof(value.c_str());
+            else if (key == "REFgamma")
+                environment.refGamma = (float)std::atof(value.c_str());
+        }
+
+        environment.directory = directory;
+        if (environment.name.empty())
+            environment.name = directory.substr(directory.find_last_of('/') + 1);
+        if (environment.evGamma <= 0.0f)
+            environment.evGamma = 1.0f;
+        if (environment.refGamma <= 0.0f)
+            environment.refGamma = 1.0f;
+
+        // Descriptors are often renamed along with their maps, so fall back to the *_Env.hdr / *_Ref.hdr in the folder
+        environment.evPath = resolve(directory, evFile, "_Env.hdr");
+        environment.refPath = resolve(directory, refFile, "_Ref.hdr");
+        if (environment.evPath.empty() && environment.refPath.empty())
+        {
+            std::cout << "ERROR::IBL::NO_HDR_MAPS " << path << std::endl;
+            return false;
+        }
+        if (environment.refPath.empty())
+        {
+            // Without a reflection map the prefiltered specular comes from the low resolution environment map
+            std::cout << "WARNING::IBL::NO_REFLECTION_MAP " << path << std::endl;
+            environment.refPath = environment.evPath;
+            environment.refMulti = environment.evMulti;
+            environment.refGamma = environment.evGamma;
+        }
+        if (environment.evPath.empty())
+        {
+            environment.evPath = environment.refPath;
+            environment.evMulti = environment.refMulti;
+            environment.evGamma = environment.refGamma;
+        }
+        return true;
+    }
+
+private:
+    static std::string resolve(const std::string& directory, const std::string& file, const std::string& suffix)
+    {
+        // only Radiance .hdr maps can be loaded
+        if (!file.empty() && hasSuffix(file, ".hdr") && std::ifstream((directory + "/" + file).c_str()))
+            return directory + "/" + file;
+
+        std::vector<std::string> files = listDirectory(directory, false);
+        for (size_t i = 0; i < files.size(); i++)
+        {
+            if (hasSuffix(files[i], suffix))
+                return directory + "/" + files[i];
+        }
+        return "";
+    }
+
+    static std::vector<std::string> listDirectory(const std::string& path, bool directories)
+    {
+        std::vector<std::string> entries;
+#ifdef _WIN32
+        _finddata_t data;
+        intptr_t handle = _findfirst((path + "/*").c_str(), &data);
+        if (handle == -1)
+            return entries;
+        do
+        {
+            std::string name = data.name;
+            if (name == "." || name == "..")
+                continue;
+            if (((data.attrib & _A_SUBDIR) != 0) == directories)
+                entries.push_back(name);
+        } while (_findnext(handle, &data) == 0);
+        _findclose(handle);
+#else
+        DIR* dir = opendir(path.c_str());
+        if (!dir)
+            return entries;
+        while (dirent* entry = readdir(dir))
+        {
+            std::string name = entry->d_name;
+            if (name == "." || name == "..")
+                continue;
+            if ((entry->d_type == DT_DIR) == directories)
+                entries.push_back(name);
+        }
+        closedir(dir);
+#endif
+        return entries;
+    }
+
+    static bool hasSuffix(const std::string& value, const std::string& suffix)
+    {
+        return value.size() >= suffix.size() && value.compare(value.size() - suffix.size(), suffix.size(), suffix) == 0;
+    }
+
+    static std::string trim(const std::string& value)
+    {
+        size_t first = value.find_first_not_of(" \t\r");
+        if (first == std::string::npos)
+            return "";
+        size_t last = value.find_last_not_of(" \t\r");
+        return value.substr(first, last - first + 1);
+    }
+};
+
+#endif // !ENVIRONMENT_H
@@ -0,0 +1,504 @@
+#pragma once
+
+#ifndef FRAMEGRAPH_H
+#define FRAMEGRAPH_H
+
+//for openGL headers
+#include <GL/glew.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <iostream>
+#include <new>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "GLResource.h"
+#include "GLState.h"
+#include "Profiler.h"
+
+// Size and format of a transient render target; the pool hands the same texture to resources with equal descriptions
+struct RenderTargetDesc
+{
+    GLsizei width, height;
+    GLenum internalFormat, format, type;
+    GLenum filter;
+
+    RenderTargetDesc() : width(0), height(0), internalFormat(GL_RGBA8), format(GL_RGBA), type(GL_UNSIGNED_BYTE), filter(GL_NEAREST)
+    {
+
+    }
+    RenderTargetDesc(GLsizei width, GLsizei height, GLenum internalFormat, GLenum format, GLenum type, GLenum filter = GL_NEAREST)
+        : width(width), height(height), internalFormat(internalFormat), format(format), type(type), filter(filter)
+    {
+
+    }
+
+    bool operator==(const RenderTargetDesc& other) const
+    {
+        return this->width == other.width && this->height == other.height && this->internalFormat == other.internalFormat
+            && this->format == other.format && this->type == other.type && this->filter == other.filter;
+    }
+
+    bool isDepth() const
+    {
+        return this->format == GL_DEPTH_COMPONENT || this->format == GL_DEPTH_STENCIL;
+    }
+};
+
+// Render targets and framebuffers shared by the frame graphs of successive frames. A target released by a pass
+// can be acquired by a later pass of the same frame (aliasing), and targets no graph used for MAX_IDLE_FRAMES
+// frames are deleted, so the memory of a disabled pipeline is given back.
+class RenderTargetPool
+{
+public:
+    static const unsigned int MAX_IDLE_FRAMES = 2;
+
+    // The label only names a new target, acquiring an existing one allocates nothing
+    GLuint acquire(const RenderTargetDesc& desc, const char* label)
+    {
+        for (size_t i = 0; i < this->targets.size(); ++i)
+        {
+            Target& target = this->targets[i];
+            if (target.inUse || !(target.desc == desc))
+                continue;
+            target.inUse = true;
+            target.idleFrames = 0;
+            return target.texture;
+        }
+
+        Target target;
+        target.desc = desc;
+        target.inUse = true;
+        target.idleFrames = 0;
+        target.texture.create(std::string("render target ") + label);
+        GLState::get().bindTexture(GL_TEXTURE_2D, target.texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, desc.internalFormat, desc.width, desc.height, 0, desc.format, desc.type, NULL);
+        target.texture.setMemory(GpuMemory::textureBytes(desc.internalFormat, desc.width, desc.height));
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, desc.filter);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, desc.filter);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        this->targets.push_back(std::move(target));
+        return this->targets.back().texture;
+    }
+
+    void release(GLuint texture)
+    {
+        for (size_t i = 0; i < this->targets.size(); ++i)
+        {
+            if (this->targets[i].texture == texture)
+                this->targets[i].inUse = false;
+        }
+    }
+
+    // Framebuffer with these attachments, created on first use; the draw buffers follow the color order
+    GLuint framebuffer(const std::vector<GLuint>& colors, GLuint depth, bool depthStencil)
+    {
+        for (size_t i = 0; i < this->framebuffers.size(); ++i)
+        {
+            if (this->framebuffers[i].colors == colors && this->framebuffers[i].depth == depth)
+                return this->framebuffers[i].fbo;
+        }
+
+        Framebuffer framebuffer;
+        framebuffer.colors = colors;
+        framebuffer.depth = depth;
+        framebuffer.fbo.create("frame graph FBO");
+        GLState::get().bindFramebuffer(GL_FRAMEBUFFER, framebuffer.fbo);
+        std::vector<GLenum> drawBuffers;
+        for (size_t i = 0; i < colors.size(); ++i)
+        {
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + i, GL_TEXTURE_2D, colors[i], 0);
+            drawBuffers.push_back(GL_COLOR_ATTACHMENT0 + i);
+        }
+        if (depth != 0)
+            glFramebufferTexture2D(GL_FRAMEBUFFER, depthStencil ? GL_DEPTH_STENCIL_ATTACHMENT : GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depth, 0);
+        if (drawBuffers.empty())
+        {
+            // a depth only framebuffer, incomplete with a read buffer it does not have
+            glDrawBuffer(GL_NONE);
+            glReadBuffer(GL_NONE);
+        }
+        else
+            glDrawBuffers((GLsizei)drawBuffers.size(), &drawBuffers[0]);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            std::cout << "ERROR::FRAME_GRAPH::FRAMEBUFFER_NOT_COMPLETE" << std::endl;
+
+        this->framebuffers.push_back(std::move(framebuffer));
+        return this->framebuffers.back().fbo;
+    }
+
+    // Framebuffer with only a depth attachment, such as the source and destination of a depth blit
+    GLuint depthFramebuffer(GLuint depth, bool depthStencil)
+    {
+        return this->framebuffer(this->noColors, depth, depthStencil);
+    }
+
+    // Called once per frame: deletes the targets idle for too long, and the framebuffers using them
+    void endFrame()
+    {
+        for (size_t i = 0; i < this->targets.size(); )
+        {
+            Target& target = this->targets[i];
+            target.inUse = false;
+            if (++target.idleFrames <= MAX_IDLE_FRAMES)
+            {
+                ++i;
+                continue;
+            }
+            GLuint texture = target.texture;
+            for (size_t j = 0; j < this->framebuffers.size(); )
+            {
+                const Framebuffer& framebuffer = this->framebuffers[j];
+                bool attached = framebuffer.depth == texture;
+                for (size_t k = 0; k < framebuffer.colors.size(); ++k)
+                    attached = attached || framebuffer.colors[k] == texture;
+                if (attached)
+                    this->framebuffers.erase(this->framebuffers.begin() + j);
+                else
+                    ++j;
+            }
+            this->targets.erase(this->targets.begin() + i);
+        }
+    }
+
+    size_t targetCount() const
+    {
+        return this->targets.size();
+    }
+
+    // Deletes every target and framebuffer, while the context is still current
+    void clear()
+    {
+        this->framebuffers.clear();
+        this->targets.clear();
+    }
+
+private:
+    struct Target
+    {
+        RenderTargetDesc desc;
+        TextureHandle texture;
+        bool inUse;
+        // frames since a graph last acquired it
+        unsigned int idleFrames;
+    };
+    struct Framebuffer
+    {
+        std::vector<GLuint> colors;
+        GLuint depth;
+        FramebufferHandle fbo;
+    };
+
+    std::vector<Target> targets;
+    std::vector<Framebuffer> framebuffers;
+    const std::vector<GLuint> noColors;
+};
+
+class FrameGraph;
+
+// Callback of a pass, stored inline: a std::function allocates once a lambda's captures outgrow its small buffer,
+// which differs between standard libraries. The lambda must fit in CAPACITY bytes and be trivially copyable, which
+// lambdas capturing by reference are; both are checked when it is added.
+class PassFunction
+{
+public:
+    static const size_t CAPACITY = 192;
+
+    PassFunction() : invoke(nullptr)
+    {
+
+    }
+
+    template <typename Function>
+    PassFunction(const Function& function) : invoke(&call<Function>)
+    {
+        static_assert(sizeof(Function) <= CAPACITY, "the pass's captures do not fit in PassFunction::CAPACITY");
+        static_assert(std::is_trivially_copyable<Function>::value, "a pass's lambda must capture by reference");
+        new (this->storage) Function(function);
+    }
+
+    void operator()(const FrameGraph& graph) const
+    {
+        this->invoke(this->storage, graph);
+    }
+
+private:
+    typedef void (*Invoke)(const void* function, const FrameGraph& graph);
+
+    alignas(std::max_align_t) unsigned char storage[CAPACITY];
+    Invoke invoke;
+
+    template <typename Function>
+    static void call(const void* function, const FrameGraph& graph)
+    {
+        (*static_cast<const Function*>(function))(graph);
+    }
+};
+
+// One frame's passes and the render targets they read and write, declared again every frame after reset().
+// compile() culls the passes whose results nothing reads, execute() runs the rest in declaration order, acquiring
+// each transient target from the pool just before its first use and releasing it after its last, so targets with
+// disjoint lifetimes share memory. Imported resources (the default framebuffer, persistent textures) are never
+// allocated, and the passes writing them are never culled.
+// The graph is kept across frames: reset() keeps the storage of the passes and resources, names are string
+// literals, so declaring the same frame again allocates nothing.
+class FrameGraph
+{
+public:
+    explicit FrameGraph(RenderTargetPool& pool) : pool(pool), passCount(0), resourceCount(0), culled(0)
+    {
+
+    }
+
+    // Forgets the previous frame's passes and resources, keeping their storage
+    void reset()
+    {
+        for (size_t i = 0; i < this->passCount; ++i)
+        {
+            this->passes[i].reads.clear();
+            this->passes[i].writes.clear();
+        }
+        this->passCount = 0;
+        this->resourceCount = 0;
+        this->culled = 0;
+    }
+
+    // Transient render target, only allocated if a pass that survives culling uses it; name must outlive the frame
+    GLuint create(const char* name, const RenderTargetDesc& desc)
+    {
+        Resource& resource = this->addResource();
+        resource.name = name;
+        resource.desc = desc;
+        resource.imported = false;
+        resource.texture = 0;
+        return (GLuint)this->resourceCount - 1;
+    }
+
+    // Existing texture, or the default framebuffer with texture 0
+    GLuint import(const char* name, GLuint texture, GLsizei width, GLsizei height)
+    {
+        Resource& resource = this->addResource();
+        resource.name = name;
+        resource.desc = RenderTargetDesc();
+        resource.desc.width = width;
+        resource.desc.height = height;
+        resource.imported = true;
+        resource.texture = texture;
+        return (GLuint)this->resourceCount - 1;
+    }
+
+    // The pass's framebuffer is bound and cleared with the clear mask before execute runs
+    GLuint addPass(const char* name, GLbitfield clear, const PassFunction& execute)
+    {
+        if (this->passCount == this->passes.size())
+            this->passes.push_back(Pass());
+        Pass& pass = this->passes[this->passCount++];
+        pass.name = name;
+        pass.clear = clear;
+        pass.execute = execute;
+        pass.culled = false;
+        return (GLuint)this->passCount - 1;
+    }
+
+    void read(GLuint pass, GLuint resource)
+    {
+        this->passes[pass].reads.push_back(resource);
+    }
+
+    // Color targets are attached in the order they are written
+    void write(GLuint pass, GLuint resource)
+    {
+        this->passes[pass].writes.push_back(resource);
+    }
+
+    // Culls the passes whose writes are never read, walking back from the imported resources
+    void compile()
+    {
+        this->passReferences.assign(this->passCount, 0);
+        this->resourceReferences.assign(this->resourceCount, 0);
+        for (size_t i = 0; i < this->passCount; ++i)
+        {
+            this->passReferences[i] = (unsigned int)this->passes[i].writes.size();
+            for (size_t j = 0; j < this->passes[i].reads.size(); ++j)
+                ++this->resourceReferences[this->passes[i].reads[j]];
+            if (this->writesImported(this->passes[i]))
+                ++this->passReferences[i];
+        }
+
+        this->unreferenced.clear();
+        for (size_t i = 0; i < this->resourceCount; ++i)
+        {
+            if (this->resourceReferences[i] == 0 && !this->resources[i].imported)
+                this->unreferenced.push_back((GLuint)i);
+        }
+        while (!this->unreferenced.empty())
+        {
+            GLuint resource = this->unreferenced.back();
+            this->unreferenced.pop_back();
+            for (size_t i = 0; i < this->passCount; ++i)
+            {
+                Pass& pass = this->passes[i];
+                if (pass.culled || std::find(pass.writes.begin(), pass.writes.end(), resource) == pass.writes.end())
+                    continue;
+                if (--this->passReferences[i] > 0)
+                    continue;
+                pass.culled = true;
+                ++this->culled;
+                for (size_t j = 0; j < pass.reads.size(); ++j)
+                {
+                    if (--this->resourceReferences[pass.reads[j]] == 0 && !this->resources[pass.reads[j]].imported)
+                        this->unreferenced.push_back(pass.reads[j]);
+                }
+            }
+        }
+
+        // lifetimes over the surviving passes
+        for (size_t i = 0; i < this->resourceCount; ++i)
+            this->resources[i].firstUse = this->resources[i].lastUse = -1;
+        for (size_t i = 0; i < this->passCount; ++i)
+        {
+            if (this->passes[i].culled)
+                continue;
+            this->extendLifetime(this->passes[i].reads, (int)i);
+            this->extendLifetime(this->passes[i].writes, (int)i);
+        }
+    }
+
+    void execute()
+    {
+        for (size_t i = 0; i < this->passCount; ++i)
+        {
+            Pass& pass = this->passes[i];
+            if (pass.culled)
+                continue;
+
+            for (size_t j = 0; j < this->resourceCount; ++j)
+            {
+                Resource& resource = this->resources[j];
+                if (!resource.imported && resource.firstUse == (int)i)
+                    resource.texture = this->pool.acquire(resource.desc, resource.name);
+            }
+
+            // each pass is a profiler scope, nested in the one the graph is executed in
+            ProfileScope scope(pass.name);
+            this->bindTargets(pass);
+            if (pass.clear != 0)
+                glClear(pass.clear);
+            pass.execute(*this);
+
+            for (size_t j = 0; j < this->resourceCount; ++j)
+            {
+                Resource& resource = this->resources[j];
+                if (!resource.imported && resource.lastUse == (int)i)
+                    this->pool.release(resource.texture);
+            }
+        }
+    }
+
+    // Texture of a resource, valid while the pass using it executes
+    GLuint texture(GLuint resource) const
+    {
+        return this->resources[resource].texture;
+    }
+
+    unsigned int culledPasses() const
+    {
+        return this->culled;
+    }
+
+private:
+    struct Resource
+    {
+        const char* name;
+        RenderTargetDesc desc;
+        bool imported;
+        GLuint texture;
+        // first and last surviving pass using it, -1 when none
+        int firstUse, lastUse;
+    };
+    struct Pass
+    {
+        const char* name;
+        GLbitfield clear;
+        PassFunction execute;
+        std::vector<GLuint> reads;
+        std::vector<GLuint> writes;
+        bool culled;
+    };
+
+    RenderTargetPool& pool;
+    // only the first passCount passes and resourceCount resources belong to the current frame
+    std::vector<Resource> resources;
+    std::vector<Pass> passes;
+    size_t passCount, resourceCount;
+    unsigned int culled;
+    // scratch of compile() and bindTargets(), kept with their capacity
+    std::vector<unsigned int> passReferences, resourceReferences;
+    std::vector<GLuint> unreferenced;
+    std::vector<GLuint> colors;
+
+    Resource& addResource()
+    {
+        if (this->resourceCount == this->resources.size())
+            this->resources.push_back(Resource());
+        return this->resources[this->resourceCount++];
+    }
+
+    bool writesImported(const Pass& pass) const
+    {
+        for (size_t i = 0; i < pass.writes.size(); ++i)
+        {
+            if (this->resources[pass.writes[i]].imported)
+                return true;
+        }
+        return false;
+    }
+
+    void extendLifetime(const std::vector<GLuint>& used, int pass)
+    {
+        for (size_t i = 0; i < used.size(); ++i)
+        {
+            Resource& resource = this->resources[used[i]];
+            if (resource.firstUse < 0)
+                resource.firstUse = pass;
+            resource.lastUse = pass;
+        }
+    }
+
+    // Binds the framebuffer of the pass's writes and sets the viewport to their size
+    void bindTargets(const Pass& pass)
+    {
+        this->colors.clear();
+        GLuint depth = 0;
+        bool depthStencil = false;
+        bool defaultFramebuffer = false;
+        GLsizei width = 0, height = 0;
+        for (size_t i = 0; i < pass.writes.size(); ++i)
+        {
+            const Resource& resource = this->resources[pass.writes[i]];
+            width = resource.desc.width;
+            height = resource.desc.height;
+            if (resource.imported && resource.texture == 0)
+                defaultFramebuffer = true;
+            else if (!resource.imported && resource.desc.isDepth())
+            {
+                depth = resource.texture;
+                depthStencil = resource.desc.format == GL_DEPTH_STENCIL;
+            }
+            else
+                this->colors.push_back(resource.texture);
+        }
+
+        if (defaultFramebuffer)
+            GLState::get().bindFramebuffer(GL_FRAMEBUFFER, 0);
+        else
+            GLState::get().bindFramebuffer(GL_FRAMEBUFFER, this->pool.framebuffer(this->colors, depth, depthStencil));
+        if (width > 0 && height > 0)
+            glViewport(0, 0, width, height);
+    }
+};
+
+#endif // !FRAMEGRAPH_H
@@ -0,0 +1,273 @@
+#pragma once
+
+#ifndef GLRESOURCE_H
+#define GLRESOURCE_H
+
+//for openGL headers
+#include <GL/glew.h>
+
+#include <map>
+#include <string>
+#include <utility>
+
+#include "GLState.h"
+
+// Kinds of OpenGL objects owned by a GLHandle
+enum GLResourceType {
+    GL_RESOURCE_TEXTURE,
+    GL_RESOURCE_FRAMEBUFFER,
+    GL_RESOURCE_RENDERBUFFER,
+    GL_RESOURCE_BUFFER
+};
+
+// Lifetime of the GL context the handles' objects belong to. The application calls contextDestroyed() once it has
+// released what it owns, before destroying the context; a handle released after that, such as a global destroyed
+// once main() returned, only forgets its name: the context is gone, and the function local statics of GpuMemory and
+// GLState may already be destroyed. The flag is a constant initialized bool, never destroyed itself.
+class GLContext
+{
+public:
+    static void contextDestroyed()
+    {
+        destroyed() = true;
+    }
+
+    static bool alive()
+    {
+        return !destroyed();
+    }
+
+private:
+    static bool& destroyed()
+    {
+        static bool flag = false;
+        return flag;
+    }
+};
+
+// Live accounting of the GPU memory held by textures, renderbuffers and buffers.
+// Sizes are estimates computed from the internal format, the driver may pad them.
+class GpuMemory
+{
+public:
+    struct Allocation
+    {
+        std::string label;
+        GLResourceType type;
+        GLsizeiptr bytes;
+    };
+
+    static void track(GLResourceType type, GLuint id, const std::string& label, GLsizeiptr bytes)
+    {
+        Allocation& allocation = allocations()[key(type, id)];
+        totalBytes() -= allocation.bytes;
+        allocation.label = label;
+        allocation.type = type;
+        allocation.bytes = bytes;
+        totalBytes() += bytes;
+    }
+
+    static void untrack(GLResourceType type, GLuint id)
+    {
+        std::map<unsigned long long, Allocation>::iterator it = allocations().find(key(type, id));
+        if (it == allocations().end())
+            return;
+        totalBytes() -= it->second.bytes;
+        allocations().erase(it);
+    }
+
+    static std::map<unsigned long long, Allocation>& allocations()
+    {
+        static std::map<unsigned long long, Allocation> registry;
+        return registry;
+    }
+
+    static GLsizeiptr& totalBytes()
+    {
+        static GLsizeiptr total = 0;
+        return total;
+    }
+
+    // Bytes per texel of the internal formats used by the renderer
+    static GLsizeiptr bytesPerTexel(GLenum internalFormat)
+    {
+        switch (internalFormat)
+        {
+        case GL_RED:
+        case GL_R8:
+            return 1;
+        case GL_R16F:
+        case GL_RG8:
+            return 2;
+        case GL_RGB:
+        case GL_RGB8:
+        case GL_SRGB8:
+            return 3;
+        case GL_RGBA:
+        case GL_RGBA8:
+        case GL_SRGB8_ALPHA8:
+        case GL_RG16:
+        case GL_RG16F:
+        case GL_R32F:
+        case GL_DEPTH_COMPONENT:
+        case GL_DEPTH_COMPONENT24:
+        case GL_DEPTH_COMPONENT32F:
+        case GL_DEPTH24_STENCIL8:
+            return 4;
+        case GL_RGB16F:
+            return 6;
+        case GL_RGBA16F:
+        case GL_RG32F:
+            return 8;
+        case GL_RGB32F:
+            return 12;
+        case GL_RGBA32F:
+            return 16;
+        default:
+            return 4;
+        }
+    }
+
+    // Size of a 2D texture, a cubemap (faces = 6) or a layered texture, optionally with its full mip chain
+    static GLsizeiptr textureBytes(GLenum internalFormat, GLsizei width, GLsizei height, GLsizei faces = 1, bool mipmapped = false)
+    {
+        GLsizeiptr bytes = 0;
+        while (true)
+        {
+            bytes += (GLsizeiptr)width * height * faces * bytesPerTexel(internalFormat);
+            if (!mipmapped || (width == 1 && height == 1))
+                break;
+            width = width > 1 ? width / 2 : 1;
+            height = height > 1 ? height / 2 : 1;
+        }
+        return bytes;
+    }
+
+private:
+    static unsigned long long key(GLResourceType type, GLuint id)
+    {
+        return ((unsigned long long)type << 32) | id;
+    }
+};
+
+// Owning handle for an OpenGL texture, framebuffer, renderbuffer or buffer.
+// The object is deleted when the handle is destroyed or re-created, so re-running
+// an init function releases the objects of the previous run instead of leaking them.
+template <GLResourceType Type>
+class GLHandle
+{
+public:
+    GLHandle() : id(0), bytes(0)
+    {
+
+    }
+    ~GLHandle()
+    {
+        this->release();
+    }
+
+    GLHandle(const GLHandle&) = delete;
+    GLHandle& operator=(const GLHandle&) = delete;
+
+    GLHandle(GLHandle&& other) : id(other.id), bytes(other.bytes), label(std::move(other.label))
+    {
+        other.id = 0;
+        other.bytes = 0;
+    }
+    GLHandle& operator=(GLHandle&& other)
+    {
+        if (this != &other)
+        {
+            this->release();
+            this->id = other.id;
+            this->bytes = other.bytes;
+            this->label = std::move(other.label);
+            other.id = 0;
+            other.bytes = 0;
+        }
+        return *this;
+    }
+
+    // Deletes the current object, if any, and generates a new one
+    GLuint create(const std::string& label)
+    {
+        this->release();
+        this->label = label;
+        switch (Type)
+        {
+        case GL_RESOURCE_TEXTURE:
+            glGenTextures(1, &this->id);
+            break;
+        case GL_RESOURCE_FRAMEBUFFER:
+            glGenFramebuffers(1, &this->id);
+            break;
+        case GL_RESOURCE_RENDERBUFFER:
+            glGenRenderbuffers(1, &this->id);
+            break;
+        case GL_RESOURCE_BUFFER:
+            glGenBuffers(1, &this->id);
+            break;
+        }
+        return this->id;
+    }
+
+    void release()
+    {
+        if (this->id == 0)
+            return;
+        if (!GLContext::alive())
+        {
+            this->id = 0;
+            this->bytes = 0;
+            return;
+        }
+        switch (Type)
+        {
+        case GL_RESOURCE_TEXTURE:
+            GLState::get().forgetTexture(this->id);
+            glDeleteTextures(1, &this->id);
+            break;
+        case GL_RESOURCE_FRAMEBUFFER:
+            GLState::get().forgetFramebuffer(this->id);
+            glDeleteFramebuffers(1, &this->id);
+            break;
+        case GL_RESOURCE_RENDERBUFFER:
+            glDeleteRenderbuffers(1, &this->id);
+            break;
+        case GL_RESOURCE_BUFFER:
+            glDeleteBuffers(1, &this->id);
+            break;
+        }
+        GpuMemory::untrack(Type, this->id);
+        this->id = 0;
+        this->bytes = 0;
+    }
+
+    // Records the size of the storage allocated for the object in the GPU memory view
+    void setMemory(GLsizeiptr bytes)
+    {
+        this->bytes = bytes;
+        GpuMemory::track(Type, this->id, this->label, bytes);
+    }
+
+    GLuint get() const
+    {
+        return this->id;
+    }
+    operator GLuint() const
+    {
+        return this->id;
+    }
+
+private:
+    GLuint id;
+    GLsizeiptr bytes;
+    std::string label;
+};
+
+typedef GLHandle<GL_RESOURCE_TEXTURE> TextureHandle;
+typedef GLHandle<GL_RESOURCE_FRAMEBUFFER> FramebufferHandle;
+typedef GLHandle<GL_RESOURCE_RENDERBUFFER> RenderbufferHandle;
+typedef GLHandle<GL_RESOURCE_BUFFER> BufferHandle;
+
+#endif // !GLRESOURCE_H
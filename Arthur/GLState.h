@@ -0,0 +1,341 @@
+#pragma once
+
+#ifndef GLSTATE_H
+#define GLSTATE_H
+
+//for openGL headers
+#include <GL/glew.h>
+
+// Shadow copy of the bindings and fixed function state changed by the renderer: setting a value that is
+// already current costs no GL call. Every bind of the renderer goes through it, code that changes this state
+// behind its back (the ImGui renderer) must be followed by invalidate().
+class GLState
+{
+public:
+    static const GLuint MAX_TEXTURE_UNITS = 16;
+
+    // GL calls made and avoided
+    struct Statistics
+    {
+        unsigned int issued;
+        unsigned int skipped;
+    };
+
+    static GLState& get()
+    {
+        static GLState state;
+        return state;
+    }
+
+    void useProgram(GLuint program)
+    {
+        if (this->check(this->program == program))
+            return;
+        glUseProgram(program);
+        this->program = program;
+    }
+
+    void bindVertexArray(GLuint vertexArray)
+    {
+        if (this->check(this->vertexArray == vertexArray))
+            return;
+        glBindVertexArray(vertexArray);
+        this->vertexArray = vertexArray;
+    }
+
+    // Only the combined GL_FRAMEBUFFER target is used by the renderer
+    void bindFramebuffer(GLenum target, GLuint framebuffer)
+    {
+        if (target != GL_FRAMEBUFFER)
+        {
+            this->issue();
+            glBindFramebuffer(target, framebuffer);
+            this->framebuffer = UNKNOWN;
+            return;
+        }
+        if (this->check(this->framebuffer == framebuffer))
+            return;
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        this->framebuffer = framebuffer;
+    }
+
+    void activeTexture(GLenum unit)
+    {
+        if (this->check(this->activeUnit == unit))
+            return;
+        glActiveTexture(unit);
+        this->activeUnit = unit;
+    }
+
+    // Binds to the active unit, like glBindTexture
+    void bindTexture(GLenum target, GLuint texture)
+    {
+        GLuint* binding = this->textureBinding(target);
+        if (binding == nullptr)
+        {
+            this->issue();
+            glBindTexture(target, texture);
+            return;
+        }
+        if (this->check(*binding == texture))
+            return;
+        glBindTexture(target, texture);
+        *binding = texture;
+    }
+
+    void enable(GLenum capability)
+    {
+        this->setCapability(capability, true);
+    }
+
+    void disable(GLenum capability)
+    {
+        this->setCapability(capability, false);
+    }
+
+    void depthFunc(GLenum function)
+    {
+        if (this->check(this->depthFunction == function))
+            return;
+        glDepthFunc(function);
+        this->depthFunction = function;
+    }
+
+    void depthMask(GLboolean mask)
+    {
+        if (this->check(this->depthWrite == (GLuint)mask))
+            return;
+        glDepthMask(mask);
+        this->depthWrite = mask;
+    }
+
+    void blendFunc(GLenum source, GLenum destination)
+    {
+        if (this->check(this->blendSource == source && this->blendDestination == destination))
+            return;
+        glBlendFunc(source, destination);
+        this->blendSource = source;
+        this->blendDestination = destination;
+    }
+
+    void colorMask(GLboolean red, GLboolean green, GLboolean blue, GLboolean alpha)
+    {
+        GLuint mask = (red ? 1 : 0) | (green ? 2 : 0) | (blue ? 4 : 0) | (alpha ? 8 : 0);
+        if (this->check(this->colorWrite == mask))
+            return;
+        glColorMask(red, green, blue, alpha);
+        this->colorWrite = mask;
+    }
+
+    void stencilFunc(GLenum function, GLint reference, GLuint mask)
+    {
+        if (this->check(this->stencilFunction == function && this->stencilReference == (GLuint)reference && this->stencilValueMask == mask))
+            return;
+        glStencilFunc(function, reference, mask);
+        this->stencilFunction = function;
+        this->stencilReference = reference;
+        this->stencilValueMask = mask;
+    }
+
+    // Operations of both faces
+    void stencilOp(GLenum stencilFail, GLenum depthFail, GLenum depthPass)
+    {
+        if (this->check(this->sameStencilOp(0, stencilFail, depthFail, depthPass) && this->sameStencilOp(1, stencilFail, depthFail, depthPass)))
+            return;
+        glStencilOp(stencilFail, depthFail, depthPass);
+        this->setStencilOp(0, stencilFail, depthFail, depthPass);
+        this->setStencilOp(1, stencilFail, depthFail, depthPass);
+    }
+
+    // Operations of GL_FRONT or GL_BACK faces
+    void stencilOpSeparate(GLenum face, GLenum stencilFail, GLenum depthFail, GLenum depthPass)
+    {
+        if (face == GL_FRONT_AND_BACK)
+        {
+            this->stencilOp(stencilFail, depthFail, depthPass);
+            return;
+        }
+        GLuint index = face == GL_FRONT ? 0 : 1;
+        if (this->check(this->sameStencilOp(index, stencilFail, depthFail, depthPass)))
+            return;
+        glStencilOpSeparate(face, stencilFail, depthFail, depthPass);
+        this->setStencilOp(index, stencilFail, depthFail, depthPass);
+    }
+
+    // Deleted names can be reused by new objects, which then must really be bound
+    void forgetProgram(GLuint program)
+    {
+        if (this->program == program)
+            this->program = UNKNOWN;
+    }
+
+    void forgetFramebuffer(GLuint framebuffer)
+    {
+        if (this->framebuffer == framebuffer)
+            this->framebuffer = UNKNOWN;
+    }
+
+    void forgetVertexArray(GLuint vertexArray)
+    {
+        if (this->vertexArray == vertexArray)
+            this->vertexArray = UNKNOWN;
+    }
+
+    void forgetTexture(GLuint texture)
+    {
+        for (GLuint unit = 0; unit < MAX_TEXTURE_UNITS; ++unit)
+        {
+            for (GLuint target = 0; target < TEXTURE_TARGETS; ++target)
+            {
+                if (this->textures[unit][target] == texture)
+                    this->textures[unit][target] = UNKNOWN;
+            }
+        }
+    }
+
+    // Forgets everything, the next call of each kind is always issued
+    void invalidate()
+    {
+        this->program = this->vertexArray = this->framebuffer = UNKNOWN;
+        this->activeUnit = UNKNOWN;
+        for (GLuint unit = 0; unit < MAX_TEXTURE_UNITS; ++unit)
+        {
+            for (GLuint target = 0; target < TEXTURE_TARGETS; ++target)
+                this->textures[unit][target] = UNKNOWN;
+        }
+        for (GLuint capability = 0; capability < CAPABILITIES; ++capability)
+            this->capabilities[capability] = UNKNOWN;
+        this->depthFunction = this->depthWrite = UNKNOWN;
+        this->blendSource = this->blendDestination = UNKNOWN;
+        this->colorWrite = UNKNOWN;
+        this->stencilFunction = this->stencilReference = this->stencilValueMask = UNKNOWN;
+        for (GLuint face = 0; face < 2; ++face)
+            this->setStencilOp(face, UNKNOWN, UNKNOWN, UNKNOWN);
+    }
+
+    // Closes the statistics of the frame, called once per frame
+    void endFrame()
+    {
+        this->lastFrame = this->current;
+        this->current.issued = this->current.skipped = 0;
+    }
+
+    const Statistics& frameStatistics() const
+    {
+        return this->lastFrame;
+    }
+
+private:
+    static const GLuint UNKNOWN = 0xFFFFFFFF;
+    static const GLuint TEXTURE_TARGETS = 4;
+    static const GLuint CAPABILITIES = 6;
+
+    GLuint program, vertexArray, framebuffer;
+    GLuint activeUnit;
+    GLuint textures[MAX_TEXTURE_UNITS][TEXTURE_TARGETS];
+    GLuint capabilities[CAPABILITIES];
+    GLuint depthFunction, depthWrite;
+    GLuint blendSource, blendDestination;
+    // red, green, blue and alpha writes as bits 0 to 3
+    GLuint colorWrite;
+    GLuint stencilFunction, stencilReference, stencilValueMask;
+    // stencil fail, depth fail and depth pass operations of the front then the back faces
+    GLuint stencilOps[2][3];
+    Statistics current, lastFrame;
+
+    GLState()
+    {
+        this->invalidate();
+        this->current.issued = this->current.skipped = 0;
+        this->lastFrame = this->current;
+    }
+
+    // Counts the call and returns true when it can be skipped
+    bool check(bool redundant)
+    {
+        if (redundant)
+            ++this->current.skipped;
+        else
+            ++this->current.issued;
+        return redundant;
+    }
+
+    void issue()
+    {
+        ++this->current.issued;
+    }
+
+    bool sameStencilOp(GLuint face, GLenum stencilFail, GLenum depthFail, GLenum depthPass) const
+    {
+        return this->stencilOps[face][0] == stencilFail && this->stencilOps[face][1] == depthFail && this->stencilOps[face][2] == depthPass;
+    }
+
+    void setStencilOp(GLuint face, GLenum stencilFail, GLenum depthFail, GLenum depthPass)
+    {
+        this->stencilOps[face][0] = stencilFail;
+        this->stencilOps[face][1] = depthFail;
+        this->stencilOps[face][2] = depthPass;
+    }
+
+    GLuint* textureBinding(GLenum target)
+    {
+        GLuint unit = this->activeUnit - GL_TEXTURE0;
+        if (this->activeUnit == UNKNOWN || unit >= MAX_TEXTURE_UNITS)
+            return nullptr;
+        switch (target)
+        {
+        case GL_TEXTURE_2D:
+            return &this->textures[unit][0];
+        case GL_TEXTURE_CUBE_MAP:
+            return &this->textures[unit][1];
+        case GL_TEXTURE_CUBE_MAP_ARRAY_ARB:
+            return &this->textures[unit][2];
+        case GL_TEXTURE_BUFFER:
+            return &this->textures[unit][3];
+        default:
+            return nullptr;
+        }
+    }
+
+    void setCapability(GLenum capability, bool enabled)
+    {
+        GLuint index;
+        switch (capability)
+        {
+        case GL_DEPTH_TEST:
+            index = 0;
+            break;
+        case GL_BLEND:
+            index = 1;
+            break;
+        case GL_CULL_FACE:
+            index = 2;
+            break;
+        case GL_STENCIL_TEST:
+            index = 3;
+            break;
+        case GL_TEXTURE_CUBE_MAP_SEAMLESS:
+            index = 4;
+            break;
+        case GL_FRAMEBUFFER_SRGB:
+            index = 5;
+            break;
+        default:
+            this->issue();
+            if (enabled)
+                glEnable(capability);
+            else
+                glDisable(capability);
+            return;
+        }
+        if (this->check(this->capabilities[index] == (GLuint)enabled))
+            return;
+        if (enabled)
+            glEnable(capability);
+        else
+            glDisable(capability);
+        this->capabilities[index] = enabled;
+    }
+};
+
+#endif // !GLSTATE_H
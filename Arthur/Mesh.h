@@ -15,6 +15,9 @@ using namespace std;
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
+#include "GLState.h"
+#include "RenderQueue.h"
+
 
 struct Vertex {
     // Position
@@ -30,6 +33,8 @@ public:
     /*  Mesh Data  */
     vector<Vertex> vertices;
     vector<GLuint> indices;
+    // Center of the bounding box, the point the render queue sorts by
+    glm::vec3 center;
 
     /*  Functions  */
     // Constructor
@@ -38,18 +43,32 @@ public:
         this->vertices = vertices;
         this->indices = indices;
 
+        glm::vec3 boxMin(0.0f), boxMax(0.0f);
+        for (GLuint i = 0; i < this->vertices.size(); i++)
+        {
+            boxMin = i == 0 ? this->vertices[i].Position : glm::min(boxMin, this->vertices[i].Position);
+            boxMax = i == 0 ? this->vertices[i].Position : glm::max(boxMax, this->vertices[i].Position);
+        }
+        this->center = (boxMin + boxMax) * 0.5f;
+
         // Now that we have all the required data, set the vertex buffers and its attribute pointers.
         this->setupMesh();
     }
 
     // Render the mesh
-    void Draw(Shader shader)
+    void Draw(const Shader& shader)
     {
-        glActiveTexture(GL_TEXTURE0);
-
-        glBindVertexArray(this->VAO);
+        // the VAO stays bound, the next draw or setup binds its own
+        GLState::get().bindVertexArray(this->VAO);
         glDrawElements(GL_TRIANGLES, this->indices.size(), GL_UNSIGNED_INT, 0);
-        glBindVertexArray(0);
+    }
+
+    // Queues the mesh instead of drawing it, depth sorted by its center
+    void Submit(RenderQueue& queue, RenderPass pass, const Shader& shader, const RenderMaterial* material,
+                const glm::mat4& model, const glm::mat4& view, float farPlane) const
+    {
+        queue.submit(pass, shader, material, this->VAO, GL_TRIANGLES, (GLsizei)this->indices.size(), true, model,
+                     RenderQueue::viewDepth(view, model, this->center, farPlane));
     }
 
 private:
@@ -65,7 +84,7 @@ private:
         glGenBuffers(1, &this->VBO);
         glGenBuffers(1, &this->EBO);
 
-        glBindVertexArray(this->VAO);
+        GLState::get().bindVertexArray(this->VAO);
         // Load data into vertex buffers
         glBindBuffer(GL_ARRAY_BUFFER, this->VBO);
         // A great thing about structs is that their memory layout is sequential for all its items.
@@ -87,7 +106,7 @@ private:
         glEnableVertexAttribArray(2);
         glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (GLvoid*)offsetof(Vertex, TexCoords));
 
-        glBindVertexArray(0);
+        GLState::get().bindVertexArray(0);
     }
 };
 
@@ -62,11 +62,18 @@ public:
         this->processNode(scene->mRootNode, scene);
     }
     // Draws the model, and thus all its meshes
-    void Draw(Shader shader)
+    void Draw(const Shader& shader)
     {
         for (GLuint i = 0; i < this->meshes.size(); i++)
             this->meshes[i].Draw(shader);
     }
+    // Queues all its meshes, each sorted by its own depth
+    void Submit(RenderQueue& queue, RenderPass pass, const Shader& shader, const RenderMaterial* material,
+                const glm::mat4& model, const glm::mat4& view, float farPlane) const
+    {
+        for (GLuint i = 0; i < this->meshes.size(); i++)
+            this->meshes[i].Submit(queue, pass, shader, material, model, view, farPlane);
+    }
 
 private:
     /*  Functions   */
@@ -194,7 +201,7 @@ GLuint TextureFromFile(const char* path, string directory, bool gamma)
         else if (nrComponents == 4)
             format = GL_RGBA;
 
-        glBindTexture(GL_TEXTURE_2D, textureID);
+        GLState::get().bindTexture(GL_TEXTURE_2D, textureID);
         glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
         glGenerateMipmap(GL_TEXTURE_2D);
 
@@ -0,0 +1,281 @@
+#pragma once
+
+#ifndef PROFILER_H
+#define PROFILER_H
+
+//for openGL headers
+#include <GL/glew.h>
+
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Nested CPU and GPU timings of named scopes. GPU times come from GL_TIMESTAMP queries written with
+// glQueryCounter at both ends of a scope; the queries of a frame are read back FRAME_LATENCY frames
+// later, when the GPU has long finished them, so profiling never waits on the GPU.
+class Profiler
+{
+public:
+    // Frames in flight before a frame's queries are read back
+    static const GLuint FRAME_LATENCY = 4;
+    static const GLuint MAX_SCOPES = 64;
+    static const GLuint MAX_DEPTH = 16;
+    // Resolved frames kept for the statistics and the trace
+    static const GLuint HISTORY = 120;
+
+    // Timings of one scope of a resolved frame, in milliseconds from the start of the frame
+    struct Scope
+    {
+        GLuint name;
+        GLuint depth;
+        double cpuStart, cpuDuration;
+        // negative when the GPU queries were not available
+        double gpuStart, gpuDuration;
+    };
+
+    struct Frame
+    {
+        // milliseconds since init(); GPU timestamps are moved to the CPU time base
+        double cpuStart, gpuStart;
+        std::vector<Scope> scopes;
+    };
+
+    static Profiler& get()
+    {
+        static Profiler profiler;
+        return profiler;
+    }
+
+    // Creates the queries, needs a GL context
+    void init()
+    {
+        glGenQueries(FRAME_LATENCY * MAX_SCOPES * 2, &this->queries[0][0]);
+        this->origin = std::chrono::steady_clock::now();
+        // pairs the two clocks once, GPU timestamps are placed on the CPU timeline with it
+        GLint64 gpuNow = 0;
+        glGetInteger64v(GL_TIMESTAMP, &gpuNow);
+        this->gpuOrigin = gpuNow;
+        for (GLuint i = 0; i < HISTORY; ++i)
+            this->history[i].scopes.reserve(MAX_SCOPES);
+        this->initialized = true;
+    }
+
+    // Resolves the frame recorded FRAME_LATENCY frames ago, then starts recording this one under a "frame" scope
+    void beginFrame()
+    {
+        if (!this->initialized || !this->enabled)
+            return;
+        ++this->frameIndex;
+        GLuint slot = this->frameIndex % FRAME_LATENCY;
+        if (this->recorded[slot].count > 0)
+            this->resolve(slot);
+
+        this->recorded[slot].count = 0;
+        this->recorded[slot].cpuStart = this->now();
+        this->depth = 0;
+        this->recording = true;
+        this->begin("frame");
+    }
+
+    void endFrame()
+    {
+        if (!this->recording)
+            return;
+        while (this->depth > 0)
+            this->end();
+        this->recording = false;
+    }
+
+    void begin(const char* name)
+    {
+        if (!this->recording || this->depth == MAX_DEPTH)
+            return;
+        GLuint slot = this->frameIndex % FRAME_LATENCY;
+        RecordedFrame& frame = this->recorded[slot];
+        if (frame.count == MAX_SCOPES)
+        {
+            // the scope is dropped but still takes a level, so end() stays balanced
+            this->open[this->depth++] = MAX_SCOPES;
+            return;
+        }
+        GLuint index = frame.count++;
+        RecordedScope& scope = frame.scopes[index];
+        scope.name = this->nameId(name);
+        scope.depth = this->depth;
+        scope.cpuBegin = this->now();
+        scope.cpuEnd = scope.cpuBegin;
+        glQueryCounter(this->queries[slot][index * 2], GL_TIMESTAMP);
+        this->open[this->depth++] = index;
+    }
+
+    void end()
+    {
+        if (!this->recording || this->depth == 0)
+            return;
+        GLuint index = this->open[--this->depth];
+        if (index == MAX_SCOPES)
+            return;
+        GLuint slot = this->frameIndex % FRAME_LATENCY;
+        this->recorded[slot].scopes[index].cpuEnd = this->now();
+        glQueryCounter(this->queries[slot][index * 2 + 1], GL_TIMESTAMP);
+    }
+
+    // Resolved frames, oldest first
+    GLuint frameCount() const
+    {
+        return this->resolvedCount < HISTORY ? this->resolvedCount : HISTORY;
+    }
+    const Frame& frame(GLuint age) const
+    {
+        GLuint first = this->resolvedCount < HISTORY ? 0 : this->resolvedCount % HISTORY;
+        return this->history[(first + age) % HISTORY];
+    }
+    const Frame& latestFrame() const
+    {
+        return this->history[(this->resolvedCount + HISTORY - 1) % HISTORY];
+    }
+
+    const std::string& name(GLuint id) const
+    {
+        return this->names[id];
+    }
+
+    // Writes the resolved frames in the Chrome trace event format (chrome://tracing, Perfetto):
+    // the CPU scopes on thread 1 and the GPU scopes on thread 2
+    bool writeChromeTrace(const std::string& path) const
+    {
+        std::ofstream file(path.c_str());
+        if (!file)
+        {
+            std::cout << "ERROR::PROFILER::TRACE_NOT_WRITTEN " << path << std::endl;
+            return false;
+        }
+        file << "{\"traceEvents\":[\n";
+        file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"CPU\"}},\n";
+        file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":2,\"args\":{\"name\":\"GPU\"}}";
+        for (GLuint i = 0; i < this->frameCount(); ++i)
+        {
+            const Frame& frame = this->frame(i);
+            for (size_t j = 0; j < frame.scopes.size(); ++j)
+            {
+                const Scope& scope = frame.scopes[j];
+                // trace times are in microseconds
+                file << ",\n{\"name\":\"" << this->names[scope.name] << "\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":"
+                     << (frame.cpuStart + scope.cpuStart) * 1000.0 << ",\"dur\":" << scope.cpuDuration * 1000.0 << "}";
+                if (scope.gpuDuration >= 0.0)
+                    file << ",\n{\"name\":\"" << this->names[scope.name] << "\",\"ph\":\"X\",\"pid\":1,\"tid\":2,\"ts\":"
+                         << (frame.gpuStart + scope.gpuStart) * 1000.0 << ",\"dur\":" << scope.gpuDuration * 1000.0 << "}";
+            }
+        }
+        file << "\n]}\n";
+        std::cout << "PROFILER - TRACE WRITTEN : " << path << std::endl;
+        return true;
+    }
+
+    bool enabled;
+
+private:
+    struct RecordedScope
+    {
+        GLuint name;
+        GLuint depth;
+        double cpuBegin, cpuEnd;
+    };
+    struct RecordedFrame
+    {
+        double cpuStart;
+        GLuint count;
+        RecordedScope scopes[MAX_SCOPES];
+    };
+
+    bool initialized, recording;
+    unsigned long long frameIndex;
+    GLuint queries[FRAME_LATENCY][MAX_SCOPES * 2];
+    RecordedFrame recorded[FRAME_LATENCY];
+    GLuint open[MAX_DEPTH];
+    GLuint depth;
+    std::chrono::steady_clock::time_point origin;
+    GLint64 gpuOrigin;
+    std::vector<std::string> names;
+    Frame history[HISTORY];
+    GLuint resolvedCount;
+
+    Profiler() : enabled(true), initialized(false), recording(false), frameIndex(0), depth(0), gpuOrigin(0), resolvedCount(0)
+    {
+        for (GLuint i = 0; i < FRAME_LATENCY; ++i)
+            this->recorded[i].count = 0;
+    }
+
+    double now() const
+    {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - this->origin).count();
+    }
+
+    // Scopes store an index, the names are compared once per scope and never copied after the first use
+    GLuint nameId(const char* name)
+    {
+        for (size_t i = 0; i < this->names.size(); ++i)
+        {
+            if (strcmp(this->names[i].c_str(), name) == 0)
+                return (GLuint)i;
+        }
+        this->names.push_back(name);
+        return (GLuint)this->names.size() - 1;
+    }
+
+    void resolve(GLuint slot)
+    {
+        const RecordedFrame& recordedFrame = this->recorded[slot];
+        Frame& frame = this->history[this->resolvedCount % HISTORY];
+        ++this->resolvedCount;
+        frame.cpuStart = recordedFrame.cpuStart;
+        frame.gpuStart = 0.0;
+        frame.scopes.clear();
+
+        // the frame's last query is the first scope's end, written after every other one
+        GLint available = GL_FALSE;
+        glGetQueryObjectiv(this->queries[slot][1], GL_QUERY_RESULT_AVAILABLE, &available);
+        for (GLuint i = 0; i < recordedFrame.count; ++i)
+        {
+            const RecordedScope& recordedScope = recordedFrame.scopes[i];
+            Scope scope;
+            scope.name = recordedScope.name;
+            scope.depth = recordedScope.depth;
+            scope.cpuStart = recordedScope.cpuBegin - recordedFrame.cpuStart;
+            scope.cpuDuration = recordedScope.cpuEnd - recordedScope.cpuBegin;
+            scope.gpuStart = scope.gpuDuration = -1.0;
+            if (available == GL_TRUE)
+            {
+                GLuint64 gpuBegin = 0, gpuEnd = 0;
+                glGetQueryObjectui64v(this->queries[slot][i * 2], GL_QUERY_RESULT, &gpuBegin);
+                glGetQueryObjectui64v(this->queries[slot][i * 2 + 1], GL_QUERY_RESULT, &gpuEnd);
+                // nanoseconds, placed on the CPU timeline through the pair sampled in init()
+                double gpuStart = (double)((GLint64)gpuBegin - this->gpuOrigin) / 1000000.0;
+                if (i == 0)
+                    frame.gpuStart = gpuStart;
+                scope.gpuStart = gpuStart - frame.gpuStart;
+                scope.gpuDuration = (double)(gpuEnd - gpuBegin) / 1000000.0;
+            }
+            frame.scopes.push_back(scope);
+        }
+    }
+};
+
+// Profiles the enclosing block
+class ProfileScope
+{
+public:
+    explicit ProfileScope(const char* name)
+    {
+        Profiler::get().begin(name);
+    }
+    ~ProfileScope()
+    {
+        Profiler::get().end();
+    }
+};
+
+#endif // !PROFILER_H
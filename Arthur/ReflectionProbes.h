@@ -0,0 +1,201 @@
+#pragma once
+
+#ifndef REFLECTIONPROBES_H
+#define REFLECTIONPROBES_H
+
+//for openGL headers
+#include <GL/glew.h>
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+// GLM Mathemtics Header
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "Shader.h"
+#include "GLResource.h"
+
+// Local reflection probe placed in the scene
+struct ReflectionProbe
+{
+    glm::vec3 position;
+    // World space box used both as the probe's area of influence and as the proxy geometry for parallax correction
+    glm::vec3 boxMin, boxMax;
+    bool captured;
+};
+
+// Reflection probes captured from the scene and prefiltered into one cube map array, one layer per probe.
+// Updates are budgeted: every frame either captures one face of a probe or prefilters one face,
+// so a probe is refreshed over 12 frames and the probes are visited round robin.
+class ReflectionProbes
+{
+public:
+    // Must match MAX_PROBES in pbrShader.frag
+    static const GLuint MAX_PROBES = 4;
+    static const GLuint CAPTURE_SIZE = 128;
+    static const GLuint MIP_LEVELS = 5;
+
+    std::vector<ReflectionProbe> probes;
+    // Prefiltered radiance of every probe, sampled by pbrShader
+    TextureHandle probeArray;
+    // Unfiltered capture of the probe being updated, source of the prefilter pass
+    TextureHandle captureCubemap;
+    FramebufferHandle captureFBO;
+    RenderbufferHandle captureRBO;
+    bool enabled;
+
+    ReflectionProbes() : enabled(true), supported(false), currentProbe(0), currentStep(0)
+    {
+
+    }
+
+    // Cube map arrays need ARB_texture_cube_map_array (core in 4.0); without it only the global environment is used
+    bool init()
+    {
+        this->supported = GLEW_ARB_texture_cube_map_array != 0;
+        if (!this->supported)
+        {
+            std::cout << "WARNING::REFLECTION_PROBES::CUBE_MAP_ARRAY_NOT_SUPPORTED" << std::endl;
+            return false;
+        }
+
+        this->probeArray.create("reflectionProbes");
+        GLState::get().bindTexture(GL_TEXTURE_CUBE_MAP_ARRAY_ARB, this->probeArray);
+        for (GLuint mip = 0; mip < MIP_LEVELS; ++mip)
+        {
+            GLsizei size = CAPTURE_SIZE >> mip;
+            glTexImage3D(GL_TEXTURE_CUBE_MAP_ARRAY_ARB, mip, GL_RGB16F, size, size, 6 * MAX_PROBES, 0, GL_RGB, GL_FLOAT, nullptr);
+        }
+        this->probeArray.setMemory(GpuMemory::textureBytes(GL_RGB16F, CAPTURE_SIZE, CAPTURE_SIZE, 6 * MAX_PROBES, true));
+        glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY_ARB, GL_TEXTURE_MAX_LEVEL, MIP_LEVELS - 1);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY_ARB, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY_ARB, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY_ARB, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY_ARB, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY_ARB, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        GLState::get().bindTexture(GL_TEXTURE_CUBE_MAP_ARRAY_ARB, 0);
+
+        this->captureCubemap.create("reflectionProbeCapture");
+        GLState::get().bindTexture(GL_TEXTURE_CUBE_MAP, this->captureCubemap);
+        for (GLuint i = 0; i < 6; ++i)
+        {
+            glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB16F, CAPTURE_SIZE, CAPTURE_SIZE, 0, GL_RGB, GL_FLOAT, nullptr);
+        }
+        glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
+        this->captureCubemap.setMemory(GpuMemory::textureBytes(GL_RGB16F, CAPTURE_SIZE, CAPTURE_SIZE, 6, true));
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        GLState::get().bindTexture(GL_TEXTURE_CUBE_MAP, 0);
+
+        // the depth buffer is shared by every mip level, smaller color attachments render to its corner
+        this->captureFBO.create("reflectionProbeFBO");
+        this->captureRBO.create("reflectionProbeRBO");
+        GLState::get().bindFramebuffer(GL_FRAMEBUFFER, this->captureFBO);
+        glBindRenderbuffer(GL_RENDERBUFFER, this->captureRBO);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, CAPTURE_SIZE, CAPTURE_SIZE);
+        this->captureRBO.setMemory(GpuMemory::textureBytes(GL_DEPTH_COMPONENT24, CAPTURE_SIZE, CAPTURE_SIZE));
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, this->captureRBO);
+        GLState::get().bindFramebuffer(GL_FRAMEBUFFER, 0);
+
+        return true;
+    }
+
+    // Adds a probe, returns its layer in the cube map array or -1 when all layers are used
+    int add(glm::vec3 position, glm::vec3 boxMin, glm::vec3 boxMax)
+    {
+        if (this->probes.size() >= MAX_PROBES)
+            return -1;
+
+        ReflectionProbe probe;
+        probe.position = position;
+        probe.boxMin = boxMin;
+        probe.boxMax = boxMax;
+        probe.captured = false;
+        this->probes.push_back(probe);
+        return (int)this->probes.size() - 1;
+    }
+
+    // Returns the work of this frame: the probe and face to update, and whether it is the capture or the prefilter of that face
+    bool nextStep(GLuint& probe, GLuint& face, bool& prefilter)
+    {
+        if (!this->supported || !this->enabled || this->probes.empty())
+            return false;
+
+        probe = this->currentProbe;
+        face = this->currentStep % 6;
+        prefilter = this->currentStep >= 6;
+
+        if (++this->currentStep == 12)
+        {
+            this->probes[this->currentProbe].captured = true;
+            this->currentStep = 0;
+            this->currentProbe = (this->currentProbe + 1) % this->probes.size();
+        }
+        return true;
+    }
+
+    // Binds the probe array and uploads the probes that have been captured at least once
+    void bind(const Shader& shader, GLuint unit) const
+    {
+        // probes are first captured in order, so the captured ones are always the first layers
+        int count = 0;
+        while (this->supported && this->enabled && count < (int)this->probes.size() && this->probes[count].captured)
+            ++count;
+
+        glm::vec3 positions[MAX_PROBES], boxMin[MAX_PROBES], boxMax[MAX_PROBES];
+        for (int i = 0; i < count; ++i)
+        {
+            positions[i] = this->probes[i].position;
+            boxMin[i] = this->probes[i].boxMin;
+            boxMax[i] = this->probes[i].boxMax;
+        }
+        shader.setInt("probeCount", count);
+        if (count > 0)
+        {
+            shader.setVec3Array("probePositions", positions, count);
+            shader.setVec3Array("probeBoxMin", boxMin, count);
+            shader.setVec3Array("probeBoxMax", boxMax, count);
+        }
+
+        if (this->supported)
+        {
+            GLState::get().activeTexture(GL_TEXTURE0 + unit);
+            GLState::get().bindTexture(GL_TEXTURE_CUBE_MAP_ARRAY_ARB, this->probeArray);
+        }
+    }
+
+    // View matrix looking down one cubemap face from a position, faces in GL_TEXTURE_CUBE_MAP_POSITIVE_X + i order
+    static glm::mat4 faceView(GLuint face, glm::vec3 position)
+    {
+        static const glm::vec3 directions[6] =
+        {
+            glm::vec3(1.0f,  0.0f,  0.0f), glm::vec3(-1.0f,  0.0f,  0.0f),
+            glm::vec3(0.0f,  1.0f,  0.0f), glm::vec3(0.0f, -1.0f,  0.0f),
+            glm::vec3(0.0f,  0.0f,  1.0f), glm::vec3(0.0f,  0.0f, -1.0f)
+        };
+        static const glm::vec3 ups[6] =
+        {
+            glm::vec3(0.0f, -1.0f,  0.0f), glm::vec3(0.0f, -1.0f,  0.0f),
+            glm::vec3(0.0f,  0.0f,  1.0f), glm::vec3(0.0f,  0.0f, -1.0f),
+            glm::vec3(0.0f, -1.0f,  0.0f), glm::vec3(0.0f, -1.0f,  0.0f)
+        };
+        return glm::lookAt(position, position + directions[face], ups[face]);
+    }
+
+    static glm::mat4 faceProjection()
+    {
+        return glm::perspective(glm::radians(90.0f), 1.0f, 0.1f, 100.0f);
+    }
+
+private:
+    bool supported;
+    GLuint currentProbe;
+    GLuint currentStep;
+};
+
+#endif // !REFLECTIONPROBES_H
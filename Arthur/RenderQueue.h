@@ -0,0 +1,284 @@
+#pragma once
+
+#ifndef RENDERQUEUE_H
+#define RENDERQUEUE_H
+
+//for openGL headers
+#include <GL/glew.h>
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// GLM Mathemtics Header
+#include <glm/glm.hpp>
+
+#include "Shader.h"
+#include "GLState.h"
+
+// Passes run in this order, the pass is the most significant field of the sort key
+enum RenderPass
+{
+    RENDER_PASS_OPAQUE = 0,
+    // sorted back to front before state, drawn after every opaque draw
+    RENDER_PASS_TRANSLUCENT = 1
+};
+
+// Textures a draw samples, consecutive draws of the same material bind nothing
+struct RenderMaterial
+{
+    static const GLuint MAX_TEXTURES = 8;
+
+    GLuint id;
+    GLuint count;
+    GLuint units[MAX_TEXTURES];
+    GLenum targets[MAX_TEXTURES];
+    GLuint textures[MAX_TEXTURES];
+
+    RenderMaterial() : count(0)
+    {
+        // 0 is left for draws without a material
+        static GLuint nextId = 0;
+        this->id = ++nextId;
+    }
+
+    void addTexture(GLuint unit, GLenum target, GLuint texture)
+    {
+        if (this->count == MAX_TEXTURES)
+            return;
+        this->units[this->count] = unit;
+        this->targets[this->count] = target;
+        this->textures[this->count] = texture;
+        ++this->count;
+    }
+
+    void clear()
+    {
+        this->count = 0;
+    }
+
+    void bind() const
+    {
+        for (GLuint i = 0; i < this->count; ++i)
+        {
+            GLState::get().activeTexture(GL_TEXTURE0 + this->units[i]);
+            GLState::get().bindTexture(this->targets[i], this->textures[i]);
+        }
+    }
+};
+
+// Everything needed to issue one draw; the shader's per pass uniforms are set before execute()
+struct DrawPacket
+{
+    const Shader* shader;
+    const RenderMaterial* material;
+    GLuint vertexArray;
+    GLenum mode;
+    // indices when indexed, vertices otherwise
+    GLsizei count;
+    bool indexed;
+    glm::mat4 model;
+};
+
+// Draws submitted in any order and executed sorted on a 64 bit key, grouping them by program, material and
+// vertex array so each state change happens once per group. Key fields, most significant first:
+//   opaque:      pass 4 | program 12 | material 12 | vertex array 12 | depth 24 (front to back, for early-z)
+//   translucent: pass 4 | inverted depth 24 | program 12 | material 12 | vertex array 12 (back to front)
+// GL names are truncated to 12 bits: a collision only costs a redundant state change, never a wrong draw.
+class RenderQueue
+{
+public:
+    // State changes and draws of the last execute()
+    struct Statistics
+    {
+        unsigned int programs;
+        unsigned int materials;
+        unsigned int vertexArrays;
+        unsigned int draws;
+    };
+
+    // Key and the packet it sorts, sorted instead of the packets themselves
+    struct SortItem
+    {
+        uint64_t key;
+        GLuint packet;
+    };
+
+    RenderQueue()
+    {
+        this->stats.programs = this->stats.materials = this->stats.vertexArrays = this->stats.draws = 0;
+    }
+
+    // Empties the queue, the storage is kept for the next frame
+    void clear()
+    {
+        this->packets.clear();
+        this->items.clear();
+    }
+
+    // Queues a draw; depth is the view distance divided by the far plane, clamped to [0, 1]
+    void submit(RenderPass pass, const Shader& shader, const RenderMaterial* material, GLuint vertexArray,
+                GLenum mode, GLsizei count, bool indexed, const glm::mat4& model, float depth)
+    {
+        DrawPacket packet;
+        packet.shader = &shader;
+        packet.material = material;
+        packet.vertexArray = vertexArray;
+        packet.mode = mode;
+        packet.count = count;
+        packet.indexed = indexed;
+        packet.model = model;
+
+        SortItem item;
+        item.key = makeKey(pass, shader.Program, material != nullptr ? material->id : 0, vertexArray, depth);
+        item.packet = (GLuint)this->packets.size();
+        this->packets.push_back(packet);
+        this->items.push_back(item);
+    }
+
+    void sort()
+    {
+        radixSort(this->items, this->scratch);
+    }
+
+    // Issues the draws in key order; sort() first, or they run in submission order
+    void execute()
+    {
+        this->stats.programs = this->stats.materials = this->stats.vertexArrays = this->stats.draws = 0;
+
+        const Shader* shader = nullptr;
+        const RenderMaterial* material = nullptr;
+        GLuint vertexArray = 0;
+        UniformHandle modelUniform;
+        for (size_t i = 0; i < this->items.size(); ++i)
+        {
+            const DrawPacket& packet = this->packets[this->items[i].packet];
+            if (packet.shader != shader)
+            {
+                shader = packet.shader;
+                shader->Use();
+                modelUniform = shader->getUniform("model");
+                ++this->stats.programs;
+            }
+            if (packet.material != material)
+            {
+                material = packet.material;
+                if (material != nullptr)
+                    material->bind();
+                ++this->stats.materials;
+            }
+            if (packet.vertexArray != vertexArray || this->stats.vertexArrays == 0)
+            {
+                vertexArray = packet.vertexArray;
+                GLState::get().bindVertexArray(vertexArray);
+                ++this->stats.vertexArrays;
+            }
+
+            shader->setMat4(modelUniform, packet.model);
+            if (packet.indexed)
+                glDrawElements(packet.mode, packet.count, GL_UNSIGNED_INT, 0);
+            else
+                glDrawArrays(packet.mode, 0, packet.count);
+            ++this->stats.draws;
+        }
+    }
+
+    // The state changes execute() would make in the current order, without issuing anything
+    Statistics countStateChanges() const
+    {
+        Statistics changes;
+        changes.programs = changes.materials = changes.vertexArrays = 0;
+        changes.draws = (unsigned int)this->items.size();
+        for (size_t i = 0; i < this->items.size(); ++i)
+        {
+            const DrawPacket& packet = this->packets[this->items[i].packet];
+            const DrawPacket* previous = i > 0 ? &this->packets[this->items[i - 1].packet] : nullptr;
+            if (previous == nullptr || packet.shader != previous->shader)
+                ++changes.programs;
+            if (previous == nullptr || packet.material != previous->material)
+                ++changes.materials;
+            if (previous == nullptr || packet.vertexArray != previous->vertexArray)
+                ++changes.vertexArrays;
+        }
+        return changes;
+    }
+
+    const Statistics& statistics() const
+    {
+        return this->stats;
+    }
+
+    size_t size() const
+    {
+        return this->items.size();
+    }
+
+    // Depth of a point for submit(): its view space distance divided by the far plane
+    static float viewDepth(const glm::mat4& view, const glm::mat4& model, const glm::vec3& point, float farPlane)
+    {
+        return -(view * model * glm::vec4(point, 1.0f)).z / farPlane;
+    }
+
+    static uint64_t makeKey(RenderPass pass, GLuint program, GLuint material, GLuint vertexArray, float depth)
+    {
+        const uint64_t DEPTH_MAX = (1 << 24) - 1;
+        depth = depth < 0.0f ? 0.0f : (depth > 1.0f ? 1.0f : depth);
+        uint64_t quantizedDepth = (uint64_t)(depth * DEPTH_MAX);
+        uint64_t state = ((uint64_t)(program & 0xFFF) << 24) | ((uint64_t)(material & 0xFFF) << 12) | (uint64_t)(vertexArray & 0xFFF);
+
+        uint64_t key = (uint64_t)(pass & 0xF) << 60;
+        if (pass == RENDER_PASS_TRANSLUCENT)
+            return key | ((DEPTH_MAX - quantizedDepth) << 36) | state;
+        return key | (state << 24) | quantizedDepth;
+    }
+
+    // Stable LSD radix sort on the keys, one byte per pass. Bytes equal in every key (unused passes,
+    // the high bits of small GL names) are skipped, so a frame typically takes 4-5 passes instead of 8.
+    static void radixSort(std::vector<SortItem>& items, std::vector<SortItem>& scratch)
+    {
+        const size_t count = items.size();
+        if (count < 2)
+            return;
+        scratch.resize(count);
+
+        // every histogram in one read of the keys
+        size_t histograms[8][256] = {};
+        for (size_t i = 0; i < count; ++i)
+        {
+            uint64_t key = items[i].key;
+            for (int byte = 0; byte < 8; ++byte)
+                ++histograms[byte][(key >> (byte * 8)) & 0xFF];
+        }
+
+        SortItem* source = &items[0];
+        SortItem* destination = &scratch[0];
+        for (int byte = 0; byte < 8; ++byte)
+        {
+            size_t* histogram = histograms[byte];
+            if (histogram[(source[0].key >> (byte * 8)) & 0xFF] == count)
+                continue;
+
+            size_t offset = 0;
+            for (int digit = 0; digit < 256; ++digit)
+            {
+                size_t digitCount = histogram[digit];
+                histogram[digit] = offset;
+                offset += digitCount;
+            }
+            for (size_t i = 0; i < count; ++i)
+                destination[histogram[(source[i].key >> (byte * 8)) & 0xFF]++] = source[i];
+            std::swap(source, destination);
+        }
+
+        if (source != &items[0])
+            items.swap(scratch);
+    }
+
+private:
+    std::vector<DrawPacket> packets;
+    std::vector<SortItem> items;
+    std::vector<SortItem> scratch;
+    Statistics stats;
+};
+
+#endif // !RENDERQUEUE_H
@@ -3,24 +3,76 @@
 #define SHADER_H
 
 #include<string.h>
+#include<string>
+#include<vector>
+#include<map>
+#include<algorithm>
 #include<fstream>
 #include<sstream>
 #include<iostream>
+#include<cstdint>
+#include<thread>
 using namespace std;
 
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
 #include<GL/glew.h> //for openGL headers
 
 // GLM Mathemtics Header
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
+#include "UniformBuffer.h"
+#include "GLState.h"
+
+// Pre-resolved uniform location, for uniforms set every frame
+struct UniformHandle
+{
+    GLint location;
+
+    UniformHandle() : location(-1)
+    {
+
+    }
+    explicit UniformHandle(GLint location) : location(location)
+    {
+
+    }
+};
+
+// On-disk cache of linked program binaries, shared by every Shader.
+// Entries are keyed by the shader sources and the driver, so a source edit or a driver update is a cache miss.
+struct ShaderBinaryCache
+{
+    std::string directory;
+    bool enabled;
+    // false to recompile everything while still refreshing the entries (cold start measurement)
+    bool readEnabled;
+    // statistics since the last reset
+    unsigned int hits, misses, rejected;
+
+    ShaderBinaryCache() : directory("shadercache"), enabled(true), readEnabled(true), hits(0), misses(0), rejected(0)
+    {
+
+    }
+
+    void resetStatistics()
+    {
+        this->hits = this->misses = this->rejected = 0;
+    }
+};
+
 class Shader
 {
 public:
     //the program ID
     GLuint Program;
     //constructor reads and builds the shader
-    Shader()
+    Shader() : Program(0), pendingProgram(0), pendingVertex(0), pendingFragment(0)
     {
 
     }
@@ -28,137 +80,750 @@ public:
     {
 
     }
-    // loading vertex and fragment shaders
-    void loadShader(const GLchar* vertexPath, const GLchar* fragmentPath)
+    // loading vertex and fragment shaders, with the permutation's defines ("NAME" or "NAME=VALUE")
+    void loadShader(const GLchar* vertexPath, const GLchar* fragmentPath, const std::vector<std::string>& defines = std::vector<std::string>())
+    {
+        this->beginLoad(vertexPath, fragmentPath, defines);
+        this->finishLoad();
+    }
+    // First half of loadShader: reads the sources and submits the compile and link without waiting on them,
+    // with KHR_parallel_shader_compile the driver works on them in the background until finishLoad()
+    void beginLoad(const GLchar* vertexPath, const GLchar* fragmentPath, const std::vector<std::string>& defines = std::vector<std::string>())
     {
-        //retrieve the vertex and fragment source code from the address path
+        this->vertexPath = vertexPath;
+        this->fragmentPath = fragmentPath;
+        this->defines = defines;
+
+        //retrieve the vertex and fragment source code from the address path, includes expanded
         string vertexCode;
         string fragmentCode;
-        ifstream vShaderFile;
-        ifstream fShaderFile;
-
-        //ensures ifstream objects can throw exceptions
-        vShaderFile.exceptions(ifstream::failbit | ifstream::badbit);
-        fShaderFile.exceptions(ifstream::failbit | ifstream::badbit);
-
-        try
-        {
-            //open files
-            vShaderFile.open(vertexPath);
-            fShaderFile.open(fragmentPath);
-            stringstream vShaderStream, fShaderStream;
-            //read files buffer content into streams
-            vShaderStream << vShaderFile.rdbuf();
-            fShaderStream << fShaderFile.rdbuf();
-            //close file handlers
-            vShaderFile.close();
-            fShaderFile.close();
-            //convert stream into GLchar array
-            vertexCode = vShaderStream.str();
-            fragmentCode = fShaderStream.str();
-        }
-        catch (ifstream::failure e)
+        this->vertexFiles.clear();
+        this->fragmentFiles.clear();
+        if (!preprocess(vertexPath, defines, vertexCode, this->vertexFiles) || !preprocess(fragmentPath, defines, fragmentCode, this->fragmentFiles))
         {
             cout << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ" << endl;
         }
 
-        const GLchar* vShaderCode = vertexCode.c_str();
-        const GLchar* fShaderCode = fragmentCode.c_str();
+        //built next to the current program, which keeps running until the new one links
+        this->abandonLoad();
+        this->pendingProgram = glCreateProgram();
+
+        //warm start: a binary linked by this driver from the same sources skips compilation
+        this->cacheFile = binaryCachePath(vertexCode, fragmentCode);
+        if (!this->loadBinary(this->cacheFile))
+            this->submitCompile(vertexCode, fragmentCode);
+    }
+    // Loads the same files and defines again, for hot reloading
+    void beginReload()
+    {
+        std::string vertexPath = this->vertexPath, fragmentPath = this->fragmentPath;
+        this->beginLoad(vertexPath.c_str(), fragmentPath.c_str(), std::vector<std::string>(this->defines));
+    }
+    // True once the submitted compile and link can be checked without blocking
+    bool loadCompleted() const
+    {
+        if (this->pendingVertex == 0 || !GLEW_KHR_parallel_shader_compile)
+            return true;
+        GLint completed = GL_TRUE;
+        glGetProgramiv(this->pendingProgram, GL_COMPLETION_STATUS_KHR, &completed);
+        return completed == GL_TRUE;
+    }
+    // Second half of loadShader: reports compile and link errors, stores the binary and builds the uniform table.
+    // The new program replaces the current one only if it linked; returns false when the last good program is kept.
+    bool finishLoad()
+    {
+        if (this->pendingProgram == 0)
+            return false;
 
-        //compile shaders
-        GLuint vertex, fragment;
         GLint success;
-        GLchar infoLog[512];
+        if (this->pendingVertex != 0)
+        {
+            this->checkCompile(this->pendingVertex, this->vertexFiles, "VERTEX");
+            this->checkCompile(this->pendingFragment, this->fragmentFiles, "FRAGMENT");
+            //printing linking errors if any
+            GLchar infoLog[512];
+            glGetProgramiv(this->pendingProgram, GL_LINK_STATUS, &success);
+            if (!success)
+            {
+                glGetProgramInfoLog(this->pendingProgram, 512, NULL, infoLog);
+                cout << "ERROR::SHADER::PROGRAM::LINKING_FAILED" << endl << infoLog << endl;
+            }
 
-        //vertex shader
-        vertex = glCreateShader(GL_VERTEX_SHADER);
-        glShaderSource(vertex, 1, &vShaderCode, NULL);
-        glCompileShader(vertex);
-        //print compile errors, if any
-        glGetShaderiv(vertex, GL_COMPILE_STATUS, &success);
-        if (!success)
+            //delete the shader resources as they are no longer required
+            glDeleteShader(this->pendingVertex);
+            glDeleteShader(this->pendingFragment);
+            this->pendingVertex = this->pendingFragment = 0;
+            this->saveBinary(this->cacheFile);
+        }
+        glGetProgramiv(this->pendingProgram, GL_LINK_STATUS, &success);
+
+        // the first load keeps even a broken program so Program is always a valid name
+        if (!success && this->Program != 0)
+        {
+            cout << "WARNING::SHADER::RELOAD_FAILED keeping the last good program of " << this->fragmentPath << endl;
+            GLState::get().forgetProgram(this->pendingProgram);
+            glDeleteProgram(this->pendingProgram);
+            this->pendingProgram = 0;
+            return false;
+        }
+        if (this->Program != 0)
         {
-            glGetShaderInfoLog(vertex, 512, NULL, infoLog);
-            cout << "ERROR::SHADER::"<<vertexPath<<"::VERTEX::COMPILATION_FAILED" << endl << infoLog << endl;
+            GLState::get().forgetProgram(this->Program);
+            glDeleteProgram(this->Program);
         }
+        this->Program = this->pendingProgram;
+        this->pendingProgram = 0;
 
-        //fragment shader
-        fragment = glCreateShader(GL_FRAGMENT_SHADER);
-        glShaderSource(fragment, 1, &fShaderCode, NULL);
-        glCompileShader(fragment);
-        //print compile errors, if any
-        glGetShaderiv(fragment, GL_COMPILE_STATUS, &success);
-        if (!success)
+        this->reflectUniforms();
+        this->bindUniformBlock("FrameBlock", FRAME_BLOCK_BINDING);
+        this->bindUniformBlock("PassBlock", PASS_BLOCK_BINDING);
+        this->bindUniformBlock("SsaoKernelBlock", SSAO_KERNEL_BLOCK_BINDING);
+
+        // a new program starts with every uniform at 0, restore the texture units
+        if (!this->samplers.empty())
+        {
+            this->Use();
+            for (size_t i = 0; i < this->samplers.size(); ++i)
+                this->setInt(this->samplers[i].first, this->samplers[i].second);
+        }
+        return success != 0;
+    }
+    // Vertex and fragment files of the last load followed by their includes
+    std::vector<std::string> sourceFiles() const
+    {
+        std::vector<std::string> files(this->vertexFiles);
+        files.insert(files.end(), this->fragmentFiles.begin(), this->fragmentFiles.end());
+        return files;
+    }
+    // True if the path is the vertex or fragment file or one of their includes
+    bool dependsOn(const std::string& path) const
+    {
+        return std::find(this->vertexFiles.begin(), this->vertexFiles.end(), path) != this->vertexFiles.end()
+            || std::find(this->fragmentFiles.begin(), this->fragmentFiles.end(), path) != this->fragmentFiles.end();
+    }
+    //use the program
+    void Use() const
+    {
+        GLState::get().useProgram(this->Program);
+    }
+    // Sets the texture unit of a sampler, kept across reloads; the program must be in use
+    void setSampler(const std::string& name, int unit)
+    {
+        for (size_t i = 0; i < this->samplers.size(); ++i)
         {
-            glGetShaderInfoLog(fragment, 512, NULL, infoLog);
-            cout << "ERROR::SHADER::"<<fragmentPath<<"::FRAGMENT::COMPILATION_FAILED" << endl << infoLog << endl;
+            if (this->samplers[i].first == name)
+            {
+                this->samplers.erase(this->samplers.begin() + i);
+                break;
+            }
         }
+        this->samplers.push_back(std::make_pair(name, unit));
+        this->setInt(name, unit);
+    }
+    // Program binary cache settings and statistics
+    static ShaderBinaryCache& binaryCache()
+    {
+        static ShaderBinaryCache cache;
+        return cache;
+    }
 
-        //shader program
-        this->Program = glCreateProgram();
-        glAttachShader(this->Program, vertex);
-        glAttachShader(this->Program, fragment);
-        glLinkProgram(this->Program);
-        //printing linking errors if any
-        glGetProgramiv(this->Program, GL_LINK_STATUS, &success);
-        if (!success)
+    // Location of an active uniform from the table built at link time, no driver call and no allocation.
+    // Returns an invalid handle (location -1, ignored by glUniform*) for names that are not active.
+    UniformHandle getUniform(const char* name) const
+    {
+        if (this->uniforms.empty())
+            return UniformHandle();
+
+        unsigned int hash = hashName(name);
+        size_t mask = this->uniforms.size() - 1;
+        for (size_t i = hash & mask; ; i = (i + 1) & mask)
         {
-            glGetProgramInfoLog(this->Program, 512, NULL, infoLog);
-            cout << "ERROR::SHADER::PROGRAM::LINKING_FAILED" << endl << infoLog << endl;
+            const UniformSlot& slot = this->uniforms[i];
+            if (slot.name.empty())
+                return UniformHandle();
+            if (slot.hash == hash && slot.name == name)
+                return UniformHandle(slot.location);
         }
+    }
+    UniformHandle getUniform(const std::string &name) const
+    {
+        return this->getUniform(name.c_str());
+    }
 
-        //delete the shader resources as they are no longer required
-        glDeleteShader(vertex);
-        glDeleteShader(fragment);
+    void setBool(UniformHandle uniform, bool value) const
+    {
+        glUniform1i(uniform.location, (int)value);
     }
-    //use the program
-    void Use()
+    void setInt(UniformHandle uniform, int value) const
+    {
+        glUniform1i(uniform.location, value);
+    }
+    void setFloat(UniformHandle uniform, float value) const
+    {
+        glUniform1f(uniform.location, value);
+    }
+    void setVec2(UniformHandle uniform, const glm::vec2 &value) const
+    {
+        glUniform2fv(uniform.location, 1, &value[0]);
+    }
+    void setVec2(UniformHandle uniform, float x, float y) const
+    {
+        glUniform2f(uniform.location, x, y);
+    }
+    void setVec3(UniformHandle uniform, const glm::vec3 &value) const
+    {
+        glUniform3fv(uniform.location, 1, &value[0]);
+    }
+    void setVec3(UniformHandle uniform, float x, float y, float z) const
+    {
+        glUniform3f(uniform.location, x, y, z);
+    }
+    // Sets count elements of a vec3 array uniform starting at the handle's element
+    void setVec3Array(UniformHandle uniform, const glm::vec3* values, GLsizei count) const
+    {
+        glUniform3fv(uniform.location, count, &values[0][0]);
+    }
+    void setMat2(UniformHandle uniform, const glm::mat2 &mat) const
+    {
+        glUniformMatrix2fv(uniform.location, 1, GL_FALSE, &mat[0][0]);
+    }
+    void setMat3(UniformHandle uniform, const glm::mat3 &mat) const
+    {
+        glUniformMatrix3fv(uniform.location, 1, GL_FALSE, &mat[0][0]);
+    }
+    void setMat4(UniformHandle uniform, const glm::mat4 &mat) const
+    {
+        glUniformMatrix4fv(uniform.location, 1, GL_FALSE, &mat[0][0]);
+    }
+
+    // Setters by name, resolved through the uniform table
+    void setBool(const char* name, bool value) const
+    {
+        this->setBool(this->getUniform(name), value);
+    }
+    void setInt(const char* name, int value) const
+    {
+        this->setInt(this->getUniform(name), value);
+    }
+    void setFloat(const char* name, float value) const
+    {
+        this->setFloat(this->getUniform(name), value);
+    }
+    void setVec2(const char* name, const glm::vec2 &value) const
+    {
+        this->setVec2(this->getUniform(name), value);
+    }
+    void setVec2(const char* name, float x, float y) const
+    {
+        this->setVec2(this->getUniform(name), x, y);
+    }
+    void setVec3(const char* name, const glm::vec3 &value) const
+    {
+        this->setVec3(this->getUniform(name), value);
+    }
+    void setVec3(const char* name, float x, float y, float z) const
+    {
+        this->setVec3(this->getUniform(name), x, y, z);
+    }
+    void setVec3Array(const char* name, const glm::vec3* values, GLsizei count) const
+    {
+        this->setVec3Array(this->getUniform(name), values, count);
+    }
+    void setMat2(const char* name, const glm::mat2 &mat) const
+    {
+        this->setMat2(this->getUniform(name), mat);
+    }
+    void setMat3(const char* name, const glm::mat3 &mat) const
     {
-        glUseProgram(this->Program);
+        this->setMat3(this->getUniform(name), mat);
     }
+    void setMat4(const char* name, const glm::mat4 &mat) const
+    {
+        this->setMat4(this->getUniform(name), mat);
+    }
+
     void setBool(const std::string &name, bool value) const
     {
-        glUniform1i(glGetUniformLocation(this->Program, name.c_str()), (int)value);
+        this->setBool(name.c_str(), value);
     }
     void setInt(const std::string &name, int value) const
     {
-        glUniform1i(glGetUniformLocation(this->Program, name.c_str()), value);
+        this->setInt(name.c_str(), value);
     }
     void setFloat(const std::string &name, float value) const
     {
-        glUniform1f(glGetUniformLocation(this->Program, name.c_str()), value);
+        this->setFloat(name.c_str(), value);
     }
     void setVec2(const std::string &name, const glm::vec2 &value) const
     {
-        glUniform2fv(glGetUniformLocation(this->Program, name.c_str()), 1, &value[0]);
+        this->setVec2(name.c_str(), value);
     }
     void setVec2(const std::string &name, float x, float y) const
     {
-        glUniform2f(glGetUniformLocation(this->Program, name.c_str()), x, y);
+        this->setVec2(name.c_str(), x, y);
     }
     void setVec3(const std::string &name, const glm::vec3 &value) const
     {
-        glUniform3fv(glGetUniformLocation(this->Program, name.c_str()), 1, &value[0]);
+        this->setVec3(name.c_str(), value);
     }
     void setVec3(const std::string &name, float x, float y, float z) const
     {
-        glUniform3f(glGetUniformLocation(this->Program, name.c_str()), x, y, z);
+        this->setVec3(name.c_str(), x, y, z);
     }
     void setMat2(const std::string &name, const glm::mat2 &mat) const
     {
-        glUniformMatrix2fv(glGetUniformLocation(this->Program, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        this->setMat2(name.c_str(), mat);
     }
     void setMat3(const std::string &name, const glm::mat3 &mat) const
     {
-        glUniformMatrix3fv(glGetUniformLocation(this->Program, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        this->setMat3(name.c_str(), mat);
     }
     void setMat4(const std::string &name, const glm::mat4 &mat) const
     {
-        glUniformMatrix4fv(glGetUniformLocation(this->Program, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        this->setMat4(name.c_str(), mat);
     }
 
 private:
+    // Open addressing hash table of the active uniforms, kept at most half full
+    struct UniformSlot
+    {
+        std::string name;
+        unsigned int hash;
+        GLint location;
+    };
+    std::vector<UniformSlot> uniforms;
 
+    // Files and defines of the last load, for reloads
+    std::string vertexPath, fragmentPath;
+    std::vector<std::string> defines;
+    // Texture units restored on every new program
+    std::vector<std::pair<std::string, int> > samplers;
+
+    // State of a load submitted by beginLoad() and not finished yet
+    GLuint pendingProgram, pendingVertex, pendingFragment;
+    // main file and includes of each stage, for compile errors
+    std::vector<std::string> vertexFiles, fragmentFiles;
+    std::string cacheFile;
+
+    // FNV-1a
+    static unsigned int hashName(const char* name)
+    {
+        unsigned int hash = 2166136261u;
+        for (; *name; ++name)
+            hash = (hash ^ (unsigned char)*name) * 16777619u;
+        return hash;
+    }
+
+    void insertUniform(const std::string& name, GLint location)
+    {
+        unsigned int hash = hashName(name.c_str());
+        size_t mask = this->uniforms.size() - 1;
+        size_t i = hash & mask;
+        while (!this->uniforms[i].name.empty() && this->uniforms[i].name != name)
+            i = (i + 1) & mask;
+        this->uniforms[i].name = name;
+        this->uniforms[i].hash = hash;
+        this->uniforms[i].location = location;
+    }
+
+    // Drops a load that was submitted but not finished
+    void abandonLoad()
+    {
+        if (this->pendingVertex != 0)
+        {
+            glDeleteShader(this->pendingVertex);
+            glDeleteShader(this->pendingFragment);
+            this->pendingVertex = this->pendingFragment = 0;
+        }
+        if (this->pendingProgram != 0)
+        {
+            GLState::get().forgetProgram(this->pendingProgram);
+            glDeleteProgram(this->pendingProgram);
+            this->pendingProgram = 0;
+        }
+    }
+
+    // Compiles both stages and links them into Program, without querying any status so the driver is free to defer the work
+    void submitCompile(const std::string& vertexCode, const std::string& fragmentCode)
+    {
+        const GLchar* vShaderCode = vertexCode.c_str();
+        const GLchar* fShaderCode = fragmentCode.c_str();
+
+        //vertex shader
+        this->pendingVertex = glCreateShader(GL_VERTEX_SHADER);
+        glShaderSource(this->pendingVertex, 1, &vShaderCode, NULL);
+        glCompileShader(this->pendingVertex);
+
+        //fragment shader
+        this->pendingFragment = glCreateShader(GL_FRAGMENT_SHADER);
+        glShaderSource(this->pendingFragment, 1, &fShaderCode, NULL);
+        glCompileShader(this->pendingFragment);
+
+        //shader program, linked with its binary retrievable for the cache
+        if (GLEW_ARB_get_program_binary)
+            glProgramParameteri(this->pendingProgram, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+        glAttachShader(this->pendingProgram, this->pendingVertex);
+        glAttachShader(this->pendingProgram, this->pendingFragment);
+        glLinkProgram(this->pendingProgram);
+    }
+
+    //print compile errors, if any; the log's source string numbers index the stage's files
+    static void checkCompile(GLuint shader, const std::vector<std::string>& files, const char* stage)
+    {
+        GLint success;
+        GLchar infoLog[512];
+        glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+        if (!success)
+        {
+            glGetShaderInfoLog(shader, 512, NULL, infoLog);
+            cout << "ERROR::SHADER::" << (files.empty() ? "" : files[0]) << "::" << stage << "::COMPILATION_FAILED" << endl << infoLog << endl;
+            for (size_t i = 1; i < files.size(); ++i)
+                cout << "    source " << i << " : " << files[i] << endl;
+        }
+    }
+
+    // Reads a shader file, injecting the defines after #version and expanding its includes.
+    // files receives the main file then every included one, in the order of the #line source numbers.
+    static bool preprocess(const std::string& path, const std::vector<std::string>& defines, std::string& source, std::vector<std::string>& files)
+    {
+        std::string defineLines;
+        for (size_t i = 0; i < defines.size(); ++i)
+        {
+            std::string define = defines[i];
+            size_t equals = define.find('=');
+            if (equals != std::string::npos)
+                define[equals] = ' ';
+            defineLines += "#define " + define + "\n";
+        }
+        source.clear();
+        return expandIncludes(path, defineLines, source, files);
+    }
+
+    // #include "file" is resolved relative to the including file and expands each file once, like #pragma once
+    static bool expandIncludes(const std::string& path, const std::string& defineLines, std::string& source, std::vector<std::string>& files)
+    {
+        ifstream file(path.c_str());
+        if (!file)
+        {
+            cout << "ERROR::SHADER::INCLUDE_NOT_FOUND " << path << endl;
+            return false;
+        }
+        for (size_t i = 0; i < files.size(); ++i)
+        {
+            if (files[i] == path)
+                return true;
+        }
+        const int sourceNumber = (int)files.size();
+        files.push_back(path);
+        std::string directory = path.substr(0, path.find_last_of("/\\") + 1);
+
+        bool ok = true;
+        int lineNumber = 0;
+        std::string line;
+        while (std::getline(file, line))
+        {
+            ++lineNumber;
+            size_t first = line.find_first_not_of(" \t");
+            if (first != std::string::npos && line.compare(first, 8, "#include") == 0)
+            {
+                size_t open = line.find('"', first + 8);
+                size_t close = open == std::string::npos ? open : line.find('"', open + 1);
+                if (close == std::string::npos)
+                {
+                    cout << "ERROR::SHADER::MALFORMED_INCLUDE " << path << "(" << lineNumber << ")" << endl;
+                    ok = false;
+                    continue;
+                }
+                source += "#line 1 " + std::to_string(files.size()) + "\n";
+                ok = expandIncludes(directory + line.substr(open + 1, close - open - 1), "", source, files) && ok;
+                source += "#line " + std::to_string(lineNumber + 1) + " " + std::to_string(sourceNumber) + "\n";
+                continue;
+            }
+
+            source += line + "\n";
+            if (first != std::string::npos && line.compare(first, 8, "#version") == 0 && !defineLines.empty())
+            {
+                source += defineLines;
+                source += "#line " + std::to_string(lineNumber + 1) + " " + std::to_string(sourceNumber) + "\n";
+            }
+        }
+        return ok;
+    }
+
+    // Cache entry of a pair of sources for the current driver, empty when the cache is unusable
+    static std::string binaryCachePath(const std::string& vertexCode, const std::string& fragmentCode)
+    {
+        ShaderBinaryCache& cache = binaryCache();
+        if (!cache.enabled || !GLEW_ARB_get_program_binary)
+            return "";
+        GLint formats = 0;
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+        if (formats == 0)
+            return "";
+
+        // 64-bit FNV-1a over the sources and the driver strings, each terminated by a 0 byte
+        uint64_t hash = 14695981039346656037ull;
+        const char* parts[5] = { vertexCode.c_str(), fragmentCode.c_str(),
+            (const char*)glGetString(GL_VENDOR), (const char*)glGetString(GL_RENDERER), (const char*)glGetString(GL_VERSION) };
+        for (int i = 0; i < 5; ++i)
+        {
+            for (const char* c = parts[i] ? parts[i] : ""; ; ++c)
+            {
+                hash = (hash ^ (unsigned char)*c) * 1099511628211ull;
+                if (*c == 0)
+                    break;
+            }
+        }
+
+        char name[17];
+        for (int i = 0; i < 16; ++i)
+            name[i] = "0123456789abcdef"[(hash >> (60 - 4 * i)) & 0xF];
+        name[16] = 0;
+        return cache.directory + "/" + name + ".bin";
+    }
+
+    // Entry layout: char[4] "GLPB", uint32 binary format, uint32 binary length, binary
+    bool loadBinary(const std::string& path)
+    {
+        ShaderBinaryCache& cache = binaryCache();
+        if (path.empty())
+            return false;
+        ifstream file(path.c_str(), ios::binary | ios::ate);
+        if (!cache.readEnabled || !file)
+        {
+            ++cache.misses;
+            return false;
+        }
+
+        std::vector<char> contents((size_t)file.tellg());
+        file.seekg(0);
+        uint32_t header[2] = { 0, 0 };
+        if (contents.size() >= 12 && file.read(&contents[0], contents.size()) && memcmp(&contents[0], "GLPB", 4) == 0)
+            memcpy(header, &contents[4], sizeof(header));
+        if (header[1] == 0 || contents.size() - 12 < header[1])
+        {
+            ++cache.rejected;
+            return false;
+        }
+
+        // the driver may still refuse a binary it produced, e.g. after a settings change it does not report in its strings
+        glProgramBinary(this->pendingProgram, (GLenum)header[0], &contents[12], (GLsizei)header[1]);
+        GLint success = 0;
+        glGetProgramiv(this->pendingProgram, GL_LINK_STATUS, &success);
+        if (!success)
+        {
+            ++cache.rejected;
+            return false;
+        }
+        ++cache.hits;
+        return true;
+    }
+
+    void saveBinary(const std::string& path) const
+    {
+        GLint success = 0, length = 0;
+        glGetProgramiv(this->pendingProgram, GL_LINK_STATUS, &success);
+        if (path.empty() || !success)
+            return;
+        glGetProgramiv(this->pendingProgram, GL_PROGRAM_BINARY_LENGTH, &length);
+        if (length <= 0)
+            return;
+
+        std::vector<char> binary(length);
+        GLenum format = 0;
+        glGetProgramBinary(this->pendingProgram, length, NULL, &format, &binary[0]);
+
+#ifdef _WIN32
+        _mkdir(binaryCache().directory.c_str());
+#else
+        mkdir(binaryCache().directory.c_str(), 0755);
+#endif
+        ofstream file(path.c_str(), ios::binary);
+        uint32_t header[2] = { (uint32_t)format, (uint32_t)length };
+        file.write("GLPB", 4);
+        file.write((const char*)header, sizeof(header));
+        file.write(&binary[0], binary.size());
+        if (!file)
+            cout << "WARNING::SHADER::BINARY_CACHE_WRITE_FAILED " << path << endl;
+    }
+
+    // Connects a std140 block of the program, if it declares it, to the buffer bound at a binding point
+    void bindUniformBlock(const char* blockName, GLuint binding)
+    {
+        GLuint index = glGetUniformBlockIndex(this->Program, blockName);
+        if (index != GL_INVALID_INDEX)
+            glUniformBlockBinding(this->Program, index, binding);
+    }
+
+    // Builds the uniform table from the linked program.
+    // Arrays are registered under their base name and under every element name ("samples", "samples[0]", ...).
+    void reflectUniforms()
+    {
+        GLint count = 0, maxLength = 0;
+        glGetProgramiv(this->Program, GL_ACTIVE_UNIFORMS, &count);
+        glGetProgramiv(this->Program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+
+        std::vector<std::pair<std::string, GLint> > active;
+        std::vector<GLchar> buffer(maxLength > 0 ? maxLength : 1);
+        for (GLint i = 0; i < count; ++i)
+        {
+            GLint size = 0;
+            GLenum type;
+            glGetActiveUniform(this->Program, (GLuint)i, (GLsizei)buffer.size(), NULL, &size, &type, &buffer[0]);
+            std::string name(&buffer[0]);
+            active.push_back(std::make_pair(name, glGetUniformLocation(this->Program, name.c_str())));
+
+            size_t bracket = name.rfind("[0]");
+            if (bracket == std::string::npos || bracket + 3 != name.size())
+                continue;
+            std::string base = name.substr(0, bracket);
+            active.push_back(std::make_pair(base, active.back().second));
+            for (GLint element = 1; element < size; ++element)
+            {
+                std::string elementName = base + "[" + std::to_string(element) + "]";
+                active.push_back(std::make_pair(elementName, glGetUniformLocation(this->Program, elementName.c_str())));
+            }
+        }
+
+        size_t capacity = 16;
+        while (capacity < active.size() * 2)
+            capacity *= 2;
+        this->uniforms.assign(capacity, UniformSlot());
+        for (size_t i = 0; i < active.size(); ++i)
+            this->insertUniform(active[i].first, active[i].second);
+    }
+};
+
+// Loads several programs at once so the driver can compile them in parallel (KHR_parallel_shader_compile).
+// Every program is submitted first, then finished in the order the driver completes them.
+class ShaderBatch
+{
+public:
+    void add(Shader& shader, const GLchar* vertexPath, const GLchar* fragmentPath, const std::vector<std::string>& defines = std::vector<std::string>())
+    {
+        Entry entry = { &shader, vertexPath, fragmentPath, defines };
+        this->entries.push_back(entry);
+    }
+
+    // Loads every added program and empties the batch; all programs are usable on return
+    void load()
+    {
+        // let the driver use as many compiler threads as it supports
+        if (GLEW_KHR_parallel_shader_compile)
+            glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+
+        std::vector<Shader*> pending;
+        for (size_t i = 0; i < this->entries.size(); ++i)
+        {
+            this->entries[i].shader->beginLoad(this->entries[i].vertexPath.c_str(), this->entries[i].fragmentPath.c_str(), this->entries[i].defines);
+            pending.push_back(this->entries[i].shader);
+        }
+        this->entries.clear();
+
+        while (!pending.empty())
+        {
+            bool progress = false;
+            for (size_t i = 0; i < pending.size(); )
+            {
+                if (pending[i]->loadCompleted())
+                {
+                    pending[i]->finishLoad();
+                    pending.erase(pending.begin() + i);
+                    progress = true;
+                }
+                else
+                    ++i;
+            }
+            if (!progress)
+                std::this_thread::yield();
+        }
+    }
+
+private:
+    struct Entry
+    {
+        Shader* shader;
+        std::string vertexPath, fragmentPath;
+        std::vector<std::string> defines;
+    };
+    std::vector<Entry> entries;
+};
+
+// Compile time variants of one vertex/fragment pair, replacing feature uniforms that would branch per fragment.
+// Bit i of a permutation mask enables the i-th feature define; each mask gets its own program, built on first use.
+class ShaderPermutations
+{
+public:
+    void init(const std::string& vertexPath, const std::string& fragmentPath, const std::vector<std::string>& features)
+    {
+        this->vertexPath = vertexPath;
+        this->fragmentPath = fragmentPath;
+        this->features = features;
+    }
+
+    // Queues a permutation in a batch so it is ready before its first frame
+    void preload(ShaderBatch& batch, unsigned int mask)
+    {
+        batch.add(this->variants[mask], this->vertexPath.c_str(), this->fragmentPath.c_str(), this->defines(mask));
+    }
+
+    Shader& get(unsigned int mask)
+    {
+        std::map<unsigned int, Shader>::iterator variant = this->variants.find(mask);
+        if (variant != this->variants.end())
+            return variant->second;
+
+        Shader& shader = this->variants[mask];
+        shader.loadShader(this->vertexPath.c_str(), this->fragmentPath.c_str(), this->defines(mask));
+        shader.Use();
+        for (size_t i = 0; i < this->samplers.size(); ++i)
+            shader.setSampler(this->samplers[i].first, this->samplers[i].second);
+        return shader;
+    }
+
+    // Sets a sampler's texture unit in every loaded permutation and in the ones loaded later; setting it again
+    // replaces its unit, the constants are set again after every reload
+    void setSampler(const std::string& name, int unit)
+    {
+        for (size_t i = 0; i < this->samplers.size(); ++i)
+        {
+            if (this->samplers[i].first == name)
+            {
+                this->samplers.erase(this->samplers.begin() + i);
+                break;
+            }
+        }
+        this->samplers.push_back(std::make_pair(name, unit));
+        for (std::map<unsigned int, Shader>::iterator variant = this->variants.begin(); variant != this->variants.end(); ++variant)
+        {
+            variant->second.Use();
+            variant->second.setSampler(name, unit);
+        }
+    }
+
+    // Every permutation loaded so far
+    void collect(std::vector<Shader*>& shaders)
+    {
+        for (std::map<unsigned int, Shader>::iterator variant = this->variants.begin(); variant != this->variants.end(); ++variant)
+            shaders.push_back(&variant->second);
+    }
+
+private:
+    std::string vertexPath, fragmentPath;
+    std::vector<std::string> features;
+    std::vector<std::pair<std::string, int> > samplers;
+    std::map<unsigned int, Shader> variants;
+
+    std::vector<std::string> defines(unsigned int mask) const
+    {
+        std::vector<std::string> enabled;
+        for (size_t i = 0; i < this->features.size(); ++i)
+        {
+            if (mask & (1u << i))
+                enabled.push_back(this->features[i]);
+        }
+        return enabled;
+    }
 };
 
 #endif // !SHADER_H
@@ -0,0 +1,176 @@
+#pragma once
+
+#ifndef SHADERWATCHER_H
+#define SHADERWATCHER_H
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+#include "Shader.h"
+
+// Hot reloading of the watched shaders: when one of their files or includes changes the program is rebuilt
+// in the background and swapped in once it links, a broken edit keeps the last good program running.
+// Changes come from inotify on Linux and from polling the files' modification times elsewhere.
+class ShaderWatcher
+{
+public:
+    ShaderWatcher() : inotifyFd(-1)
+    {
+
+    }
+    ~ShaderWatcher()
+    {
+#ifdef __linux__
+        if (this->inotifyFd >= 0)
+            close(this->inotifyFd);
+#endif
+    }
+
+    // Starts watching directories; inotify is not recursive, so sub directories are listed too
+    void init(const std::vector<std::string>& directories)
+    {
+#ifdef __linux__
+        this->inotifyFd = inotify_init1(IN_NONBLOCK);
+        for (size_t i = 0; this->inotifyFd >= 0 && i < directories.size(); ++i)
+        {
+            // editors either rewrite the file or move a new one over it
+            int wd = inotify_add_watch(this->inotifyFd, directories[i].c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+            if (wd >= 0)
+                this->directories[wd] = directories[i];
+        }
+        if (this->inotifyFd < 0)
+            std::cout << "WARNING::SHADER_WATCHER::INOTIFY_UNAVAILABLE polling modification times" << std::endl;
+#endif
+        this->lastPoll = std::chrono::steady_clock::now();
+    }
+
+    void watch(Shader& shader)
+    {
+        this->shaders.push_back(&shader);
+    }
+
+    // Permutations are looked up on every change, so variants built later are watched too
+    void watch(ShaderPermutations& permutations)
+    {
+        this->permutations.push_back(&permutations);
+    }
+
+    // Called once per frame: starts the reload of shaders whose files changed and finishes the ones the driver completed.
+    // Returns true when a program was replaced, uniforms set once on the old program must then be set again.
+    bool update()
+    {
+        std::vector<std::string> changed = this->changedFiles();
+        if (!changed.empty())
+        {
+            std::vector<Shader*> watched = this->watchedShaders();
+            for (size_t i = 0; i < watched.size(); ++i)
+            {
+                for (size_t j = 0; j < changed.size(); ++j)
+                {
+                    if (!watched[i]->dependsOn(changed[j]))
+                        continue;
+                    std::cout << "SHADER - RELOADING : " << changed[j] << std::endl;
+                    // a reload still in flight is dropped by beginReload()
+                    watched[i]->beginReload();
+                    if (std::find(this->pending.begin(), this->pending.end(), watched[i]) == this->pending.end())
+                        this->pending.push_back(watched[i]);
+                    break;
+                }
+            }
+        }
+
+        bool replaced = false;
+        for (size_t i = 0; i < this->pending.size(); )
+        {
+            if (this->pending[i]->loadCompleted())
+            {
+                replaced = this->pending[i]->finishLoad() || replaced;
+                this->pending.erase(this->pending.begin() + i);
+            }
+            else
+                ++i;
+        }
+        return replaced;
+    }
+
+private:
+    int inotifyFd;
+    std::map<int, std::string> directories;
+    std::vector<Shader*> shaders;
+    std::vector<ShaderPermutations*> permutations;
+    std::vector<Shader*> pending;
+
+    // Modification times for the polling fallback
+    std::map<std::string, time_t> modified;
+    std::chrono::steady_clock::time_point lastPoll;
+
+    std::vector<Shader*> watchedShaders()
+    {
+        std::vector<Shader*> watched = this->shaders;
+        for (size_t i = 0; i < this->permutations.size(); ++i)
+            this->permutations[i]->collect(watched);
+        return watched;
+    }
+
+    std::vector<std::string> changedFiles()
+    {
+        std::vector<std::string> changed;
+#ifdef __linux__
+        if (this->inotifyFd >= 0)
+        {
+            char buffer[4096];
+            ssize_t length;
+            while ((length = read(this->inotifyFd, buffer, sizeof(buffer))) > 0)
+            {
+                for (char* event = buffer; event < buffer + length; )
+                {
+                    const inotify_event* notification = (const inotify_event*)event;
+                    if (notification->len > 0)
+                        changed.push_back(this->directories[notification->wd] + "/" + notification->name);
+                    event += sizeof(inotify_event) + notification->len;
+                }
+            }
+            return changed;
+        }
+#endif
+        // twice a second is enough for an editor save and keeps the stat calls out of most frames
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        if (now - this->lastPoll < std::chrono::milliseconds(500))
+            return changed;
+        this->lastPoll = now;
+
+        std::vector<Shader*> watched = this->watchedShaders();
+        for (size_t i = 0; i < watched.size(); ++i)
+        {
+            std::vector<std::string> files = watched[i]->sourceFiles();
+            for (size_t j = 0; j < files.size(); ++j)
+            {
+                struct stat info;
+                if (stat(files[j].c_str(), &info) != 0)
+                    continue;
+                std::map<std::string, time_t>::iterator previous = this->modified.find(files[j]);
+                if (previous == this->modified.end())
+                    this->modified[files[j]] = info.st_mtime;
+                else if (previous->second != info.st_mtime)
+                {
+                    previous->second = info.st_mtime;
+                    changed.push_back(files[j]);
+                }
+            }
+        }
+        return changed;
+    }
+};
+
+#endif // !SHADERWATCHER_H
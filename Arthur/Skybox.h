@@ -15,6 +15,9 @@
 // GLFW Header
 #include <GLFW/glfw3.h>
 
+#include "GLResource.h"
+#include "CubemapFile.h"
+
 class Skybox
 {
 public:
@@ -27,8 +30,18 @@ public:
 
     }
 
+    // Loads <path>/skybox.cube, which building CubemapConvert produces for every skybox of the GUI; decodes the
+    // six JPG faces when it is missing
     GLuint configureSkybox(std::string path)
     {
+        CubemapFile file;
+        if (file.read(path + "/skybox.cube"))
+        {
+            GLuint tex = loadCubemapFile(file, path);
+            if (tex != 0)
+                return tex;
+        }
+
         std::string right = "/right.jpg";
         std::string left = "/left.jpg";
         std::string top = "/top.jpg";
@@ -52,7 +65,7 @@ public:
         faces.push_back(finalBottom.c_str());
         faces.push_back(finalBack.c_str());
         faces.push_back(finalFront.c_str());
-        GLuint tex = loadCubemap(faces);
+        GLuint tex = loadCubemap(faces, path);
 
         //cout << tex << endl;
 
@@ -60,6 +73,8 @@ public:
     }
 
 private:
+    // Cubemap of the current skybox, released when another skybox is configured
+    TextureHandle cubemapTexture;
 
     void skyboxInit()
     {
@@ -111,12 +126,12 @@ private:
         GLuint skyboxVAO, skyboxVBO;
         glGenVertexArrays(1, &skyboxVAO);
         glGenBuffers(1, &skyboxVBO);
-        glBindVertexArray(skyboxVAO);
+        GLState::get().bindVertexArray(skyboxVAO);
         glBindBuffer(GL_ARRAY_BUFFER, skyboxVBO);
         glBufferData(GL_ARRAY_BUFFER, sizeof(skyboxVertices), &skyboxVertices, GL_STATIC_DRAW);
         glEnableVertexAttribArray(0);
         glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(GLfloat), (GLvoid*)0);
-        glBindVertexArray(0);
+        GLState::get().bindVertexArray(0);
     }
 
     // Loads a cubemap texture from 6 individual texture faces
@@ -127,33 +142,80 @@ private:
     // -Y (bottom)
     // +Z (front)
     // -Z (back)
-    GLuint loadCubemap(vector<const GLchar*> faces)
+    GLuint loadCubemap(vector<const GLchar*> faces, std::string name)
     {
-        GLuint textureID;
-        glGenTextures(1, &textureID);
+        GLuint textureID = this->cubemapTexture.create("skybox " + name);
 
         int width, height;
         unsigned char* image;
 
-        glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
+        GLState::get().bindTexture(GL_TEXTURE_CUBE_MAP, textureID);
         for (GLuint i = 0; i < faces.size(); i++)
         {
             image = SOIL_load_image(faces[i], &width, &height, 0, SOIL_LOAD_RGB);
             glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, image);
             SOIL_free_image_data(image);
         }
+        this->cubemapTexture.setMemory(GpuMemory::textureBytes(GL_RGB, width, height, 6));
         glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
         glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
         glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
         glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
         glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-        glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+        GLState::get().bindTexture(GL_TEXTURE_CUBE_MAP, 0);
 
         //cout << textureID << endl;
 
         return textureID;
     }
 
+    // Uploads all faces and mip levels of a cubemap container, returns 0 if its format is not supported
+    GLuint loadCubemapFile(const CubemapFile& file, std::string name)
+    {
+        GLenum internalFormat = GL_RGB;
+        if (file.format == CUBEMAP_BC1)
+        {
+            if (!GLEW_EXT_texture_compression_s3tc)
+                return 0;
+            internalFormat = GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+        }
+        else if (file.format == CUBEMAP_BC6H)
+        {
+            if (!GLEW_ARB_texture_compression_bptc)
+                return 0;
+            internalFormat = GL_COMPRESSED_RGB_BPTC_UNSIGNED_FLOAT_ARB;
+        }
+
+        GLuint textureID = this->cubemapTexture.create("skybox " + name);
+
+        GLState::get().bindTexture(GL_TEXTURE_CUBE_MAP, textureID);
+        // rows of the small RGB8 mips are not 4 byte aligned
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        for (GLuint level = 0; level < file.levels; level++)
+        {
+            GLsizei size = CubemapFile::levelSize(file.size, level);
+            for (GLuint i = 0; i < 6; i++)
+            {
+                const uint8_t* faceData = &file.data[file.offset(level, i)];
+                if (file.format == CUBEMAP_RGB8)
+                    glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, level, GL_RGB, size, size, 0, GL_RGB, GL_UNSIGNED_BYTE, faceData);
+                else
+                    glCompressedTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, level, internalFormat, size, size, 0, (GLsizei)CubemapFile::faceBytes(file.format, size), faceData);
+            }
+        }
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        this->cubemapTexture.setMemory((GLsizeiptr)file.data.size());
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAX_LEVEL, file.levels - 1);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, file.levels > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+        GLState::get().bindTexture(GL_TEXTURE_CUBE_MAP, 0);
+
+        return textureID;
+    }
+
 
 };
 
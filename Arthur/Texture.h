@@ -6,14 +6,17 @@
 #include <GL\glew.h>
 #include <stb_image_aug.h>
 
+#include <algorithm>
 #include <iostream>
 #include <string>
 
+#include "GLResource.h"
+#include "BrdfLut.h"
 
 class Texture
 {
 public:
-    GLuint texID;
+    TextureHandle texID;
     GLenum texType, texInternalFormat,texFormat;
     std::string name;
 
@@ -21,45 +24,42 @@ public:
     {
 
     }
-
-    ~Texture()
-    {
-        glDeleteTextures(1, &this->texID);
-    }
     
     GLuint loadTexture(GLchar* path, std::string name)
     {
         this->name = name;
-        // Generate texture ID and load texture data 
-        glGenTextures(1, &this->texID);
+        // Generate texture ID and load texture data, releasing the previously loaded texture
+        this->texID.create(name);
         int width, height;
         unsigned char* image = SOIL_load_image(path, &width, &height, 0, SOIL_LOAD_RGB);
         // Assign texture to ID
-        glBindTexture(GL_TEXTURE_2D, this->texID);
+        GLState::get().bindTexture(GL_TEXTURE_2D, this->texID);
         glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, image);
         glGenerateMipmap(GL_TEXTURE_2D);
+        this->texID.setMemory(GpuMemory::textureBytes(GL_RGB, width, height, 1, true));
 
         // Parameters
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-        glBindTexture(GL_TEXTURE_2D, 0);
+        GLState::get().bindTexture(GL_TEXTURE_2D, 0);
         SOIL_free_image_data(image);
         
         return this->texID;
     }
 
-    GLuint loadHDR(GLchar* path, std::string name)
+    // flipVertically is needed for equirectangular maps stored top row first, unless a pre-flipped copy is loaded
+    GLuint loadHDR(const GLchar* path, std::string name, bool flipVertically = false)
     {
         this->name = name;
         this->texType = GL_TEXTURE_2D;
 
         std::string tempPath = std::string(path);
 
-        glGenTextures(1, &this->texID);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, this->texID);
+        this->texID.create(name);
+        GLState::get().activeTexture(GL_TEXTURE0);
+        GLState::get().bindTexture(GL_TEXTURE_2D, this->texID);
 
         if (stbi_is_hdr(tempPath.c_str()))
         {
@@ -68,6 +68,14 @@ public:
             
             if (texData)
             {
+                if (flipVertically)
+                {
+                    // swap rows in place so the first row uploaded is the bottom one
+                    int rowSize = width * numComponents;
+                    for (int y = 0; y < height / 2; ++y)
+                        std::swap_ranges(texData + y * rowSize, texData + (y + 1) * rowSize, texData + (height - 1 - y) * rowSize);
+                }
+
                 // Need a higher precision format for HDR to not lose informations, thus 32bits floating point
                 if (numComponents == 3)
                 {
@@ -88,6 +96,7 @@ public:
                 glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
                 glGenerateMipmap(GL_TEXTURE_2D);
+                this->texID.setMemory(GpuMemory::textureBytes(this->texInternalFormat, width, height, 1, true));
             }
 
             else
@@ -103,7 +112,37 @@ public:
             std::cerr << "HDR TEXTURE - FILE IS NOT HDR : " << path << std::endl;
         }
 
-        glBindTexture(GL_TEXTURE_2D, 0);
+        GLState::get().bindTexture(GL_TEXTURE_2D, 0);
+
+        return this->texID;
+    }
+
+    // Uploads a BRDF lookup table generated offline by BrdfLutGen
+    GLuint loadBRDFLUT(const std::string& path, std::string name)
+    {
+        this->name = name;
+        this->texType = GL_TEXTURE_2D;
+
+        BrdfLut lut;
+        if (!lut.read(path))
+            return 0;
+
+        this->texInternalFormat = lut.channels == 3 ? GL_RGB16F : GL_RG16F;
+        this->texFormat = lut.channels == 3 ? GL_RGB : GL_RG;
+
+        this->texID.create(name);
+        GLState::get().bindTexture(GL_TEXTURE_2D, this->texID);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 2);
+        glTexImage2D(GL_TEXTURE_2D, 0, this->texInternalFormat, lut.width, lut.height, 0, this->texFormat, GL_HALF_FLOAT, &lut.texels[0]);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        this->texID.setMemory(GpuMemory::textureBytes(this->texInternalFormat, lut.width, lut.height));
+
+        // be sure to set wrapping mode to GL_CLAMP_TO_EDGE
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        GLState::get().bindTexture(GL_TEXTURE_2D, 0);
 
         return this->texID;
     }
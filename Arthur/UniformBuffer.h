@@ -0,0 +1,81 @@
+#pragma once
+
+#ifndef UNIFORMBUFFER_H
+#define UNIFORMBUFFER_H
+
+//for openGL headers
+#include <GL/glew.h>
+
+#include <string>
+
+// GLM Mathemtics Header
+#include <glm/glm.hpp>
+
+#include "GLResource.h"
+
+// Binding points of the uniform blocks shared by the shaders in shaders/.
+// Shader binds blocks with these names to these points when it links a program.
+enum UniformBlockBinding {
+    FRAME_BLOCK_BINDING = 0,
+    PASS_BLOCK_BINDING = 1,
+    SSAO_KERNEL_BLOCK_BINDING = 2
+};
+
+// std140 mirrors of the GLSL blocks; a vec3 followed by a float shares one 16 byte slot
+
+// Main camera, uploaded once per frame
+struct FrameBlock
+{
+    glm::mat4 view;
+    glm::mat4 projection;
+    glm::vec3 camPos;
+    float time;
+    // positions are rebuilt from the depth buffer with it
+    glm::mat4 inverseProjection;
+};
+
+// Camera of the pass being rendered, for shaders also used by offscreen captures (cubemap faces, reflection probes)
+struct PassBlock
+{
+    glm::mat4 view;
+    glm::mat4 projection;
+    glm::vec3 viewPos;
+    float padding;
+};
+
+// SSAO sample kernel, uploaded once by ssaoInit(); vec3 array elements are padded to vec4 in std140
+struct SsaoKernelBlock
+{
+    glm::vec4 samples[64];
+};
+
+static_assert(sizeof(FrameBlock) == 208, "FrameBlock must match the std140 layout");
+static_assert(sizeof(PassBlock) == 144, "PassBlock must match the std140 layout");
+static_assert(sizeof(SsaoKernelBlock) == 1024, "SsaoKernelBlock must match the std140 layout");
+
+// Uniform buffer holding one block, bound to its binding point for the lifetime of the buffer
+template <typename Block>
+class UniformBuffer
+{
+public:
+    BufferHandle buffer;
+
+    void create(const std::string& label, GLuint binding)
+    {
+        this->buffer.create(label);
+        glBindBuffer(GL_UNIFORM_BUFFER, this->buffer);
+        glBufferData(GL_UNIFORM_BUFFER, sizeof(Block), nullptr, GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        glBindBufferBase(GL_UNIFORM_BUFFER, binding, this->buffer);
+        this->buffer.setMemory(sizeof(Block));
+    }
+
+    void update(const Block& block)
+    {
+        glBindBuffer(GL_UNIFORM_BUFFER, this->buffer);
+        glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(Block), &block);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    }
+};
+
+#endif // !UNIFORMBUFFER_H
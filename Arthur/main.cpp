@@ -10,6 +10,12 @@
 // Standard C++ Headers
 #include <string>
 #include <random>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <cstring>
+#include <chrono>
+#include <algorithm>
 
 // GLEW Header
 #define GLEW_STATIC
@@ -24,6 +30,16 @@
 #include "Model.h"
 #include "Skybox.h"
 #include "Texture.h"
+#include "GLResource.h"
+#include "Environment.h"
+#include "ReflectionProbes.h"
+#include "ShaderWatcher.h"
+#include "GLState.h"
+#include "RenderQueue.h"
+#include "FrameGraph.h"
+#include "Profiler.h"
+#include "DynamicResolution.h"
+#include "ClusteredLights.h"
 
 // GLM Mathemtics Header
 #include <glm/glm.hpp>
@@ -43,13 +59,46 @@
 
 // Setup functions for various purposes
 // guiSetup() to initialize ImGUI and UI menu options
-// gBufferInit(), ssaoInit() and pbrInit() to initialize framebuffers for the gBuffer, SSAO and PBR pipelines respectively
+// ssaoInit() to build the SSAO kernel and noise, and pbrInit() to bake the PBR environment maps
+// loadEnvironment() to load the maps of a registered sIBL environment and bake it with pbrInit()
+// loadShaders() to build every program in one batch, from the program binary cache when possible
+// configureShaderConstants() to set the uniforms that only change with a new program, at startup and after hot reloads
 void guiSetup();
-void gBufferInit();
+// profilerGui() to show the profiler's per scope timings and the flame view of the latest frame
+void profilerGui();
+void loadShaders();
+void configureShaderConstants();
+void benchmarkShaderLoading();
+void benchmarkRenderQueue();
+// benchmarkGBuffer() to time the fill and read of the G-buffer layouts at 1080p and 4K
+void benchmarkGBuffer();
+// benchmarkClusteredLights() to time the deferred lighting of growing light counts, clustered, with every light per pixel
+// and as light volumes
+void benchmarkClusteredLights();
 void ssaoInit();
-void pbrInit();
+// ssaoHistoryInit() to (re)allocate the two accumulation targets of the temporal SSAO, keeping their names
+void ssaoHistoryInit(GLsizei width, GLsizei height);
+void pbrInit(const Environment& environment);
+void loadEnvironment(int index);
+void updateReflectionProbes(const glm::mat4& model);
+// clusteredLightsInit() to scatter the clustered point lights around the model, the same lights for the same arguments
+void clusteredLightsInit(int count, float radius, float intensity);
 void skyboxInit();
+
+// G-buffer layout: the depth target, then the color targets in the geometry pass's output order
+struct GBufferLayout
+{
+    static const int TARGETS = 4;
+    RenderTargetDesc targets[TARGETS];
+};
+// gBufferLayout() for the compact layout of shaders/include/gbuffer.glsl, or the position/normal/albedo one it replaced
+GBufferLayout gBufferLayout(GLsizei width, GLsizei height, bool legacy);
+// gBufferTraffic() for the bytes a frame moves through a layout: written once by the geometry pass, read once by the lighting
+GLsizeiptr gBufferTraffic(const GBufferLayout& layout);
 void fixScreenSize(GLFWwindow* window);
+// shutdown() to release the GL objects of the global handles and the render target pool, then destroy the context;
+// handles destroyed after it, when main() has returned, no longer call GL
+void shutdown();
 
 // Callback functions for user interaction
 // key_callback() for keyboard input
@@ -62,10 +111,21 @@ void mouse_button_callback(GLFWwindow* window, int button, int action, int mods)
 void mouse_callback(GLFWwindow* window, double xpos, double ypos);
 void Do_Movement();
 
+// Draws the PBR scene from a camera, shared by the main view and the reflection probe captures;
+// only the main view is lit by the clustered lights, their grid is built for its camera
+void renderPbrScene(const glm::mat4& model, const glm::mat4& view, const glm::mat4& projection, const glm::vec3& viewPos, bool clusteredLighting);
+// Adds the clustered lights to the bound target one bounding sphere at a time, over the pixels each one's stencil
+// pass marks; the target has a stencil and a copy of the G-buffer's depth, the G-buffer is bound as for the lighting
+void renderLightVolumes(const glm::mat4& view);
+// Uploads the camera of the pass about to be drawn, read by every shader declaring PassBlock
+void updatePassBlock(const glm::mat4& view, const glm::mat4& projection, const glm::vec3& viewPos);
+
 // Shape functions to render Spheres, Quads and Cubes
 void RenderCube();
 void RenderQuad();
 void RenderSphere();
+// Builds the sphere's buffers, RenderSphere() does it on first use
+void sphereInit();
 
 // Computation function to calculate linear interpolation
 GLfloat lerp(GLfloat a, GLfloat b, GLfloat f);
@@ -75,7 +135,14 @@ GLfloat lerp(GLfloat a, GLfloat b, GLfloat f);
 // WINDOW PROPERTIES
 // GLFW window creation and screen size specification
 GLFWwindow* window;
+// Size of the framebuffer everything renders at: the window's at startup (--size), then kept up to date by
+// framebuffer_size_callback; the frame graph sizes its targets from it and the pool reallocates them on a change
 GLuint SCREEN_WIDTH = 1920, SCREEN_HEIGHT = 1080;
+// Sphere shared by the PBR object and the lights, built by sphereInit()
+GLuint sphereVAO = 0;
+GLuint indexCount;
+// Far plane of the camera and the probe captures, the render queue's depths are relative to it
+const GLfloat FAR_PLANE = 100.0f;
 
 // ================================
 
@@ -112,16 +179,37 @@ bool pbrActive = true;
 
 
 // SSAO variables
-int num_samples = 64;
-int kernelSize = 64;
+int kernelSize = 16;
 float ssaoRadius = 0.5;
 float ssaoBias = 0.025;
 int power = 2;
+// Resolution of the occlusion: 0 full, 1 half, 2 quarter; reduced ones are upsampled by the lighting pass
+int ssaoResolution = 1;
+// Taps on each side of the separable bilateral blur
+int ssaoBlurRadius = 4;
+// Occlusion method: 0 hemisphere kernel, 1 GTAO horizon search (also gives the bent normals the lighting uses)
+int aoMethod = 1;
+int gtaoSlices = 2;
+int gtaoSteps = 4;
+// Temporal accumulation: samples rotated every frame, previous result reprojected and blended with this weight
+bool ssaoTemporal = true;
+float ssaoTemporalBlend = 0.1f;
 
 // PBR variables
 float metallic = 0.5;
 float roughness = 0.5;
 
+// Material of the deferred model, stored in the G-buffer; a roughness of 0.58 gives the former Blinn-Phong exponent of 16
+float deferredMetallic = 0.0f;
+float deferredRoughness = 0.58f;
+
+// Point lights shaded through the cluster grid by the deferred and PBR paths
+int clusteredLightCount = 256;
+float clusteredLightRadius = 3.0f;
+float clusteredLightIntensity = 4.0f;
+// The deferred path draws the same lights as stencil culled light volumes instead of through the cluster grid
+bool deferredLightVolumes = false;
+
 
 // ================================
 
@@ -138,24 +226,66 @@ bool mouseClickActive;
 GLfloat deltaTime = 0.0f;
 GLfloat lastFrame = 0.0f;
 
-// gBuffer
-GLuint gBuffer;
-GLuint gPosition, gNormal, gAlbedo;
+// Transient render targets of the deferred pipeline (gBuffer, SSAO), allocated by its frame graph
+// and deleted a few frames after the pipeline stops running
+RenderTargetPool renderTargetPool;
+// Passes of the scene, declared again every frame into the same storage
+FrameGraph frameGraph(renderTargetPool);
 
 // SSAO
-GLuint ssaoFBO, ssaoBlurFBO; 
-GLuint ssaoColorBuffer, ssaoColorBufferBlur;
 std::vector<glm::vec3> ssaoKernel;
-GLuint noiseTexture;
+TextureHandle noiseTexture;
+// accumulation of the temporal SSAO, ping-ponged: one is the history read while the other is written
+TextureHandle ssaoHistory[2];
+GLsizei ssaoHistoryWidth = 0, ssaoHistoryHeight = 0;
+bool ssaoHistoryValid = false;
+unsigned int ssaoFrame = 0;
+glm::mat4 ssaoPreviousView, ssaoPreviousProjection;
 
 // PBR
-GLuint hdrTexture;
-GLuint envCubemap;
-GLuint captureFBO;
-GLuint captureRBO;
-GLuint irradianceMap;
-GLuint prefilterMap;
-GLuint brdfLUTTexture;
+// GPU objects are owned by handles so that re-running pbrInit() on an environment switch releases the previous ones
+GLuint hdrTexture, hdrIrradianceTexture;
+TextureHandle envCubemap;
+TextureHandle irradianceSourceCubemap;
+FramebufferHandle captureFBO;
+RenderbufferHandle captureRBO;
+TextureHandle irradianceMap;
+TextureHandle prefilterMap;
+// Pre-resolved uniforms of the arrays uploaded every frame
+UniformHandle pbrLightPositionsUniform, pbrLightColorsUniform;
+UniformHandle lightVolumeModelUniform, lightVolumeStencilModelUniform;
+UniformHandle lightVolumePositionUniform, lightVolumeRadiusUniform, lightVolumeColorUniform;
+// Uniform blocks shared by the shaders: main camera per frame, camera of the current pass, SSAO kernel
+UniformBuffer<FrameBlock> frameBlock;
+UniformBuffer<PassBlock> passBlock;
+UniformBuffer<SsaoKernelBlock> ssaoKernelBlock;
+// Local reflection probes, blended over the global environment by pbrShader
+ReflectionProbes reflectionProbes;
+// Rebuilds the shaders when their files under shaders/ are saved
+ShaderWatcher shaderWatcher;
+// Every bind goes through the state cache, redundant ones are skipped
+GLState& glState = GLState::get();
+// Draws of the scene's objects, sorted by pass, program, material, VAO and depth before they are issued
+RenderQueue renderQueue;
+// CPU and GPU timings of the frame's passes, read back a few frames late
+Profiler& profiler = Profiler::get();
+// Point lights assigned to a froxel grid each frame, a fragment only shades the lights of its cluster
+ClusteredLights clusteredLights;
+// Scale of the scene's render targets, steered by the scene's GPU time; upscaled and sharpened to the backbuffer
+DynamicResolution dynamicResolution;
+float upscaleSharpness = 0.5f;
+glm::vec3 lightPositions[] = {
+    glm::vec3(-5.0f,  5.0f, 5.0f),
+    glm::vec3(5.0f,  5.0f, 5.0f),
+    glm::vec3(0.0f, 5.0f, -5.0f),
+    glm::vec3(0.0f, -10.0f, 0.0f),
+};
+glm::vec3 lightColors[] = {
+    glm::vec3(300.0f, 300.0f, 300.0f),
+    glm::vec3(300.0f, 300.0f, 300.0f),
+    glm::vec3(300.0f, 300.0f, 300.0f),
+    glm::vec3(300.0f, 300.0f, 300.0f)
+};
 
 // Model
 Model ourModel;
@@ -181,44 +311,126 @@ Texture objectMetallic;
 Texture objectRoughness;
 Texture objectNormal;
 Texture objectAO;
-// Environment map variable
+// The PBR textures above as a render queue material, refreshed since switching materials reloads them
+RenderMaterial pbrMaterial;
+// Environment map variables, the reflection map and the small environment map used for diffuse lighting
 Texture envHDR;
+Texture envIrradianceHDR;
+// Environments listed from the .ibl descriptors in the image folders
+EnvironmentRegistry environmentRegistry;
+int currentEnvironment = -1;
+// Split-sum BRDF lookup table, environment independent and generated offline by BrdfLutGen
+Texture brdfLUT;
 
 // Shaders
 Shader gridShader;
 Shader lightSource;
-Shader modelShader;
 Shader modelReflection;
 Shader skyboxShader;
 Shader floorShader;
-Shader modelGeometryPass;
-Shader modelLightingPass;
+// Shaders compiled per feature combination, the bits select the defines given to init() in loadShaders()
+ShaderPermutations modelShader;
+ShaderPermutations modelGeometryPass;
+ShaderPermutations modelLightingPass;
+enum ModelShaderFeatures { FORWARD_DIRECTIONAL_LIGHT = 1 << 0 };
+enum ModelGeometryFeatures { GEOMETRY_SSAO = 1 << 0, GEOMETRY_INVERTED_NORMALS = 1 << 1 };
+enum ModelLightingFeatures { LIGHTING_SSAO = 1 << 0, LIGHTING_SSAO_UPSAMPLE = 1 << 1, LIGHTING_SSAO_BENT_NORMALS = 1 << 2,
+                             LIGHTING_CLUSTERED = 1 << 3, LIGHTING_CLUSTERED_NAIVE = 1 << 4 };
 Shader ssaoShader;
+Shader gtaoShader;
 Shader ssaoBlurShader;
+Shader ssaoDownsampleShader;
+Shader ssaoTemporalShader;
+Shader upscaleShader;
+Shader lightVolumeShader;
+Shader lightVolumeStencilShader;
 Shader pbrShader;
 Shader rectToCubemap;
 Shader irradianceShader;
 Shader prefilterShader;
-Shader brdfShader;
 Shader backgroundShader;
 
 
 
+// ================================
+
+// ALLOCATION COUNTER
+// Replaces the global operator new to count heap allocations, the render loop is expected to make none
+
+std::atomic<unsigned long long> heapAllocations(0);
+unsigned long long frameAllocations = 0;
+
+void* operator new(std::size_t size)
+{
+    ++heapAllocations;
+    void* memory = std::malloc(size > 0 ? size : 1);
+    if (!memory)
+        throw std::bad_alloc();
+    return memory;
+}
+
+void operator delete(void* memory) noexcept
+{
+    std::free(memory);
+}
+
 // ================================
 
 // MAIN FUNCTION
-int main()
+int main(int argc, char** argv)
 {
+    bool shaderBenchmark = false;
+    bool gBufferBenchmark = false;
+    bool lightsBenchmark = false;
+    bool hidden = false;
+    for (int i = 1; i < argc; ++i)
+    {
+        // --size WIDTHxHEIGHT for the window, --hidden to run without showing it (benchmarks, captures)
+        if (strcmp(argv[i], "--size") == 0 && i + 1 < argc)
+        {
+            char* end;
+            long width = strtol(argv[++i], &end, 10);
+            long height = *end == 'x' ? strtol(end + 1, &end, 10) : 0;
+            if (width > 0 && height > 0)
+            {
+                SCREEN_WIDTH = (GLuint)width;
+                SCREEN_HEIGHT = (GLuint)height;
+            }
+            else
+                std::cout << "WARNING::MAIN::INVALID_SIZE " << argv[i] << std::endl;
+        }
+        if (strcmp(argv[i], "--hidden") == 0)
+            hidden = true;
+        if (strcmp(argv[i], "--shader-benchmark") == 0)
+            shaderBenchmark = true;
+        if (strcmp(argv[i], "--gbuffer-benchmark") == 0)
+            gBufferBenchmark = true;
+        if (strcmp(argv[i], "--lights-benchmark") == 0)
+            lightsBenchmark = true;
+        // the queue benchmark needs no window, it only sorts and counts
+        if (strcmp(argv[i], "--queue-benchmark") == 0)
+        {
+            benchmarkRenderQueue();
+            return 0;
+        }
+    }
+
     // Initializing GLFW, specifying version of OpenGL in Core profile
     glfwInit();
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-    glfwWindowHint(GLFW_RESIZABLE, GL_FALSE);
+    glfwWindowHint(GLFW_RESIZABLE, GL_TRUE);
+    glfwWindowHint(GLFW_VISIBLE, hidden ? GL_FALSE : GL_TRUE);
 
     // Window creation
     window = glfwCreateWindow(SCREEN_WIDTH, SCREEN_HEIGHT, "Arthur", nullptr, nullptr); // Windowed
     glfwMakeContextCurrent(window);
+    // the framebuffer can be larger than the window on high DPI displays
+    int framebufferWidth, framebufferHeight;
+    glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
+    SCREEN_WIDTH = framebufferWidth;
+    SCREEN_HEIGHT = framebufferHeight;
 
     // Setting callback functions for keyboard/mouse input
     glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
@@ -240,28 +452,63 @@ int main()
     // Define the viewport dimensions
     glViewport(0, 0, SCREEN_WIDTH, SCREEN_HEIGHT);
 
+    // Timer queries for the profiler
+    profiler.init();
+    dynamicResolution.init();
+
     // Setup some OpenGL options
-    glEnable(GL_DEPTH_TEST);
+    glState.enable(GL_DEPTH_TEST);
     // enable seamless cubemap sampling for lower mip levels in the pre-filter map.
-    glEnable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
+    glState.enable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
+
+    // BRDF LUT, uploaded once; environment switches only re-bake the cubemaps. Loaded before the shaders, its
+    // channels select the PBR shader's permutation
+    brdfLUT.loadBRDFLUT("images/brdfLUT.bin", "brdfLUT");
     
+    // Startup benchmark: load every program cold (compiled) then warm (from the binary cache) and exit
+    if (shaderBenchmark)
+    {
+        benchmarkShaderLoading();
+        shutdown();
+        return 0;
+    }
+    // G-buffer benchmark: fill and read the current and the former layout at 1080p and 4K, then exit
+    if (gBufferBenchmark)
+    {
+        benchmarkGBuffer();
+        shutdown();
+        return 0;
+    }
+
     // List of shaders
-    gridShader.loadShader("shaders/gridTexture.vert", "shaders/gridTexture.frag");
-    lightSource.loadShader("shaders/lightSource.vert", "shaders/lightSource.frag");
-    modelShader.loadShader("shaders/model_loading.vert", "shaders/model_loading.frag");
-    modelReflection.loadShader("shaders/model_reflection.vert", "shaders/model_reflection.frag");
-    skyboxShader.loadShader("shaders/skybox.vert", "shaders/skybox.frag");
-    floorShader.loadShader("shaders/floorShader.vert", "shaders/floorShader.frag");
-    modelGeometryPass.loadShader("shaders/model_geometry.vert", "shaders/model_geometry.frag");
-    modelLightingPass.loadShader("shaders/model_lighting.vert", "shaders/model_lighting.frag");
-    ssaoShader.loadShader("shaders/model_lighting.vert", "shaders/ssaoShader.frag");
-    ssaoBlurShader.loadShader("shaders/model_lighting.vert", "shaders/ssaoBlur.frag");
-    pbrShader.loadShader("shaders/pbrShader.vert", "shaders/pbrShader.frag");
-    rectToCubemap.loadShader("shaders/rectToCubemap.vert", "shaders/rectToCubemap.frag");
-    irradianceShader.loadShader("shaders/rectToCubemap.vert", "shaders/pbrIrradiance.frag");
-    prefilterShader.loadShader("shaders/rectToCubemap.vert", "shaders/prefilter.frag");
-    brdfShader.loadShader("shaders/brdf.vert", "shaders/brdf.frag");
-    backgroundShader.loadShader("shaders/background.vert", "shaders/background.frag");
+    loadShaders();
+    shaderWatcher.init({ "shaders", "shaders/include" });
+    shaderWatcher.watch(gridShader);
+    shaderWatcher.watch(lightSource);
+    shaderWatcher.watch(modelReflection);
+    shaderWatcher.watch(skyboxShader);
+    shaderWatcher.watch(floorShader);
+    shaderWatcher.watch(modelShader);
+    shaderWatcher.watch(modelGeometryPass);
+    shaderWatcher.watch(modelLightingPass);
+    shaderWatcher.watch(ssaoShader);
+    shaderWatcher.watch(gtaoShader);
+    shaderWatcher.watch(ssaoBlurShader);
+    shaderWatcher.watch(ssaoDownsampleShader);
+    shaderWatcher.watch(ssaoTemporalShader);
+    shaderWatcher.watch(upscaleShader);
+    shaderWatcher.watch(lightVolumeShader);
+    shaderWatcher.watch(lightVolumeStencilShader);
+    shaderWatcher.watch(pbrShader);
+    shaderWatcher.watch(rectToCubemap);
+    shaderWatcher.watch(irradianceShader);
+    shaderWatcher.watch(prefilterShader);
+    shaderWatcher.watch(backgroundShader);
+
+    // Uniform buffers, bound once to the binding points the shaders were linked against
+    frameBlock.create("frameBlock", FRAME_BLOCK_BINDING);
+    passBlock.create("passBlock", PASS_BLOCK_BINDING);
+    ssaoKernelBlock.create("ssaoKernelBlock", SSAO_KERNEL_BLOCK_BINDING);
 
     // configure skybox
     skyboxInit();
@@ -273,39 +520,64 @@ int main()
     // Setting default model
     ourModel.loadModel("models/shaderball_small.obj");
     
-    // configure g-buffer framebuffer
-    gBufferInit();
-
-    // configure framebuffer for SSAO
+    // configure SSAO kernel and noise
     ssaoInit();
+
+    clusteredLights.init();
+    clusteredLightsInit(clusteredLightCount, clusteredLightRadius, clusteredLightIntensity);
     
     // lighting info
     glm::vec3 ssaoLightPos = glm::vec3(0.0, 12.0, 0.0);
     glm::vec3 ssaoLightColor = glm::vec3(1.0, 1.0, 1.0);
 
     // shader configuration
-    modelLightingPass.Use();
-    modelLightingPass.setInt("gPosition", 0);
-    modelLightingPass.setInt("gNormal", 1);
-    modelLightingPass.setInt("gAlbedo", 2);
-    modelLightingPass.setInt("ssao", 3);
+    modelLightingPass.setSampler("gDepth", 0);
+    modelLightingPass.setSampler("gNormal", 1);
+    modelLightingPass.setSampler("gAlbedo", 2);
+    modelLightingPass.setSampler("ssao", 3);
+    modelLightingPass.setSampler("ssaoBentNormal", 4);
+    modelLightingPass.setSampler("gMaterial", 5);
+    modelLightingPass.setSampler("clusterGrid", 6);
+    modelLightingPass.setSampler("clusterLightIndices", 7);
+    modelLightingPass.setSampler("clusterLightData", 8);
     ssaoShader.Use();
-    ssaoShader.setInt("gPosition", 0);
-    ssaoShader.setInt("gNormal", 1);
-    ssaoShader.setInt("texNoise", 2);
+    ssaoShader.setSampler("gDepth", 0);
+    ssaoShader.setSampler("gNormal", 1);
+    ssaoShader.setSampler("texNoise", 2);
+    gtaoShader.Use();
+    gtaoShader.setSampler("gDepth", 0);
+    gtaoShader.setSampler("gNormal", 1);
+    gtaoShader.setSampler("texNoise", 2);
     ssaoBlurShader.Use();
-    ssaoBlurShader.setInt("ssaoInput", 0);
+    ssaoBlurShader.setSampler("ssaoInput", 0);
+    ssaoDownsampleShader.Use();
+    ssaoDownsampleShader.setSampler("gDepth", 0);
+    ssaoDownsampleShader.setSampler("gNormal", 1);
+    ssaoTemporalShader.Use();
+    ssaoTemporalShader.setSampler("ssaoInput", 0);
+    ssaoTemporalShader.setSampler("ssaoHistory", 1);
+    upscaleShader.Use();
+    upscaleShader.setSampler("scene", 0);
+    lightVolumeShader.Use();
+    lightVolumeShader.setSampler("gDepth", 0);
+    lightVolumeShader.setSampler("gNormal", 1);
+    lightVolumeShader.setSampler("gAlbedo", 2);
+    lightVolumeShader.setSampler("gMaterial", 5);
 
     // PBR Shader configuration
     pbrShader.Use();
-    pbrShader.setInt("irradianceMap", 0);
-    pbrShader.setInt("prefilterMap", 1);
-    pbrShader.setInt("brdfLUT", 2);
-    pbrShader.setInt("albedoMap", 3);
-    pbrShader.setInt("normalMap", 4);
-    pbrShader.setInt("metallicMap", 5);
-    pbrShader.setInt("roughnessMap", 6);
-    pbrShader.setInt("aoMap", 7);
+    pbrShader.setSampler("irradianceMap", 0);
+    pbrShader.setSampler("prefilterMap", 1);
+    pbrShader.setSampler("brdfLUT", 2);
+    pbrShader.setSampler("albedoMap", 3);
+    pbrShader.setSampler("normalMap", 4);
+    pbrShader.setSampler("metallicMap", 5);
+    pbrShader.setSampler("roughnessMap", 6);
+    pbrShader.setSampler("aoMap", 7);
+    pbrShader.setSampler("probeMap", 8);
+    pbrShader.setSampler("clusterGrid", 9);
+    pbrShader.setSampler("clusterLightIndices", 10);
+    pbrShader.setSampler("clusterLightData", 11);
 
     // PBR texture loading
     objectAlbedo.loadTexture("images/rustediron/albedo.png", "albedo");
@@ -314,36 +586,29 @@ int main()
     objectRoughness.loadTexture("images/rustediron/roughness.png", "roughness");
     objectAO.loadTexture("images/rustediron/ao.png", "ao");
 
+    configureShaderConstants();
+
     // HDR Background
     backgroundShader.Use();
-    backgroundShader.setInt("environmentMap", 0);
+    backgroundShader.setSampler("environmentMap", 0);
 
-    // Load HDR texture
-    hdrTexture = envHDR.loadHDR("images/loft/Newport_Loft_Ref_Flip.hdr", "loft");
-    
-    // PBR setup
-    pbrInit();
+    // List the environments and bake the default one
+    environmentRegistry.scan("images");
+    int defaultEnvironment = environmentRegistry.find("Newport Loft");
+    loadEnvironment(defaultEnvironment >= 0 ? defaultEnvironment : 0);
     
-    glm::vec3 lightPositions[] = {
-        glm::vec3(-5.0f,  5.0f, 5.0f),
-        glm::vec3(5.0f,  5.0f, 5.0f),
-        glm::vec3(0.0f, 5.0f, -5.0f),
-        glm::vec3(0.0f, -10.0f, 0.0f),
-    };
-    glm::vec3 lightColors[] = {
-        glm::vec3(300.0f, 300.0f, 300.0f),
-        glm::vec3(300.0f, 300.0f, 300.0f),
-        glm::vec3(300.0f, 300.0f, 300.0f),
-        glm::vec3(300.0f, 300.0f, 300.0f)
-    };
+    // Reflection probes in front of and behind the model, their boxes overlap around it so the two blend
+    reflectionProbes.init();
+    reflectionProbes.add(glm::vec3(-0.5f, 0.5f, 3.5f), glm::vec3(-8.0f, -6.0f, -2.0f), glm::vec3(8.0f, 8.0f, 10.0f));
+    reflectionProbes.add(glm::vec3(-0.5f, 0.5f, -3.5f), glm::vec3(-8.0f, -6.0f, -10.0f), glm::vec3(8.0f, 8.0f, 2.0f));
 
-    // Initializing static shader uniforms before rendering
-    glm::mat4 projection;
-    projection = glm::perspective(camera.Zoom, (float)SCREEN_WIDTH / (float)SCREEN_HEIGHT, 0.1f, 100.0f);
-    pbrShader.Use();
-    pbrShader.setMat4("projection", projection);
-    backgroundShader.Use();
-    backgroundShader.setMat4("projection", projection);
+    // Lights benchmark: the deferred lighting of 64 to 4096 lights, clustered and naive, then exit
+    if (lightsBenchmark)
+    {
+        benchmarkClusteredLights();
+        shutdown();
+        return 0;
+    }
 
     // then before rendering, configure the viewport to the original framebuffer's screen dimensions
     fixScreenSize(window);
@@ -353,14 +618,21 @@ int main()
     // GAME LOOP
     while (!glfwWindowShouldClose(window))
     {
+        unsigned long long frameStartAllocations = heapAllocations;
+
         // Set frame time
         GLfloat currentFrame = glfwGetTime();
         deltaTime = currentFrame - lastFrame;
         lastFrame = currentFrame;
+        profiler.beginFrame();
 
         // Check and call events
         glfwPollEvents();
         Do_Movement();
+        profiler.begin("shader reload");
+        if (shaderWatcher.update())
+            configureShaderConstants();
+        profiler.end();
         ImGui_ImplGlfwGL3_NewFrame();
 
         // Clear the colorbuffer
@@ -370,209 +642,456 @@ int main()
         glm::mat4 model;
         glm::mat4 view;
         view = camera.GetViewMatrix();
+        // every frame, the window can be resized; a scaled render keeps the aspect ratio
+        glm::mat4 projection = glm::perspective(camera.Zoom, (float)SCREEN_WIDTH / (float)SCREEN_HEIGHT, 0.1f, FAR_PLANE);
         model = glm::translate(model, glm::vec3(-0.5f, -1.0f, 0.0f)); // Translating to center of screen
         model = glm::rotate(model, rotationAngle, glm::vec3(rotX, rotY, rotZ));
         model = glm::scale(model, modelScale);	// Scaling with ImGui
 
+        // Main camera, read by every shader declaring FrameBlock
+        FrameBlock frame;
+        frame.view = view;
+        frame.projection = projection;
+        frame.camPos = camera.Position;
+        frame.time = currentFrame;
+        frame.inverseProjection = glm::inverse(projection);
+        frameBlock.update(frame);
+
         // GUI
         guiSetup();
 
+        // budgeted probe update, rendered at its own size before the main view
         if (pbrActive)
         {
-            pbrShader.Use();
-            pbrShader.setMat4("view", view);
-            pbrShader.setVec3("camPos", camera.Position);
-
-            // bind pre-computed IBL data
-            glActiveTexture(GL_TEXTURE0);
-            glBindTexture(GL_TEXTURE_CUBE_MAP, irradianceMap);
-            glActiveTexture(GL_TEXTURE1);
-            glBindTexture(GL_TEXTURE_CUBE_MAP, prefilterMap);
-            glActiveTexture(GL_TEXTURE2);
-            glBindTexture(GL_TEXTURE_2D, brdfLUTTexture);
-
-            // PBR textures            
-            glActiveTexture(GL_TEXTURE3);
-            glBindTexture(GL_TEXTURE_2D, objectAlbedo.getTextureID());
-            glActiveTexture(GL_TEXTURE4);
-            glBindTexture(GL_TEXTURE_2D, objectNormal.getTextureID());
-            glActiveTexture(GL_TEXTURE5);
-            glBindTexture(GL_TEXTURE_2D, objectMetallic.getTextureID());
-            glActiveTexture(GL_TEXTURE6);
-            glBindTexture(GL_TEXTURE_2D, objectRoughness.getTextureID());
-            glActiveTexture(GL_TEXTURE7);
-            glBindTexture(GL_TEXTURE_2D, objectAO.getTextureID());
-
-            pbrShader.setMat4("model", model);
-            RenderSphere();
-            //ourModel.Draw(pbrShader);
-            
-            for (GLuint i = 0; i < sizeof(lightPositions) / sizeof(lightPositions[0]); ++i)
-            {
-                glm::vec3 newPos = lightPositions[i] + glm::vec3(sin(glfwGetTime() * 5.0) * 5.0, 0.0, 0.0);
-                newPos = lightPositions[i];
-                pbrShader.setVec3("lightPositions[" + std::to_string(i) + "]", newPos);
-                pbrShader.setVec3("lightColors[" + std::to_string(i) + "]", lightColors[i]);
-
-                lightSource.Use();
-                lightSource.setMat4("projection", projection);
-                lightSource.setMat4("view", view);
-                model = glm::mat4();
-                model = glm::translate(model, lightPositions[i]);
-                model = glm::scale(model, glm::vec3(0.5f)); // Make it a smaller cube
-                lightSource.setMat4("model", model);
-                RenderSphere();
-            }
+            profiler.begin("reflection probes");
+            updateReflectionProbes(model);
+            profiler.end();
+        }
 
+        // The scene's passes are scheduled by a frame graph with targets from renderTargetPool. Below full scale the
+        // scene renders to a reduced color and depth target, upscaled to the backbuffer; otherwise straight to it,
+        // unless the light volumes need it offscreen: the default framebuffer cannot be attached with their depth.
+        dynamicResolution.beginFrame();
+        FrameGraph& graph = frameGraph;
+        graph.reset();
+        int backbufferWidth, backbufferHeight;
+        glfwGetFramebufferSize(window, &backbufferWidth, &backbufferHeight);
+        GLuint backbuffer = graph.import("backbuffer", 0, backbufferWidth, backbufferHeight);
+        const float renderScale = dynamicResolution.scale();
+        const GLsizei renderWidth = (GLsizei)(SCREEN_WIDTH * renderScale + 0.5f);
+        const GLsizei renderHeight = (GLsizei)(SCREEN_HEIGHT * renderScale + 0.5f);
+        const bool upscale = renderWidth != backbufferWidth || renderHeight != backbufferHeight;
+        const bool pointLights = clusteredLights.enabled && !clusteredLights.lights.empty();
+        const bool lightVolumes = pointLights && deferredRendering && deferredLightVolumes;
+        const bool offscreen = upscale || lightVolumes;
+        GLuint sceneColor = backbuffer, sceneDepth = backbuffer;
+        if (offscreen)
+        {
+            sceneColor = graph.create("sceneColor", RenderTargetDesc(renderWidth, renderHeight, GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, GL_LINEAR));
+            sceneDepth = graph.create("sceneDepth", RenderTargetDesc(renderWidth, renderHeight, GL_DEPTH_COMPONENT24, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT));
+        }
+        // the backbuffer was cleared above, an offscreen target is cleared by the first pass drawing to it
+        const GLbitfield sceneClear = offscreen ? GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT : 0;
+        // set by the deferred path when its temporal SSAO writes the history
+        bool ssaoHistoryWritten = false;
+
+        // the lights of the main camera's clusters, for the target the scene is shaded in
+        const bool clusteredLighting = pointLights && (pbrActive || (deferredRendering && !lightVolumes));
+        if (clusteredLighting)
+        {
+            profiler.begin("light assignment");
+            clusteredLights.update(view, projection, 0.1f, FAR_PLANE, renderWidth, renderHeight);
+            profiler.end();
+        }
 
-            // render skybox (render as last to prevent overdraw)
-            glDepthFunc(GL_LEQUAL);
-            backgroundShader.Use();
-            backgroundShader.setMat4("view", view);
-            glActiveTexture(GL_TEXTURE0);
-            glBindTexture(GL_TEXTURE_CUBE_MAP, envCubemap);
-            RenderCube();
+        if (pbrActive)
+        {
+            GLuint pbrScene = graph.addPass("pbr scene", sceneClear, [&](const FrameGraph&)
+            {
+                renderPbrScene(model, view, projection, camera.Position, clusteredLighting);
+            });
+            graph.write(pbrScene, sceneColor);
+            if (offscreen)
+                graph.write(pbrScene, sceneDepth);
         }
 
         if (deferredRendering) 
         {
-            // Deferred Rendering
+            // Deferred Rendering: the SSAO passes are culled when the lighting pass does not read their result
+            const GBufferLayout layout = gBufferLayout(renderWidth, renderHeight, false);
+            GLuint gDepth = graph.create("gDepth", layout.targets[0]);
+            GLuint gNormal = graph.create("gNormal", layout.targets[1]);
+            GLuint gAlbedo = graph.create("gAlbedo", layout.targets[2]);
+            GLuint gMaterial = graph.create("gMaterial", layout.targets[3]);
+            GLuint ssaoNoise = graph.import("ssaoNoise", noiseTexture, 4, 4);
+            // at half or quarter resolution the occlusion reads a downsampled depth and normal
+            const GLsizei ssaoScale = 1 << ssaoResolution;
+            const GLsizei ssaoWidth = renderWidth / ssaoScale, ssaoHeight = renderHeight / ssaoScale;
+            GLuint ssaoDepth = gDepth, ssaoNormal = gNormal;
+            if (ssaoScale > 1)
+            {
+                ssaoDepth = graph.create("ssaoDepth", RenderTargetDesc(ssaoWidth, ssaoHeight, GL_R32F, GL_RED, GL_FLOAT));
+                ssaoNormal = graph.create("ssaoNormal", RenderTargetDesc(ssaoWidth, ssaoHeight, GL_RG16, GL_RG, GL_UNSIGNED_SHORT));
+            }
+            // occlusion packed with its view depth and octahedral normal, the guides of the blur and the upsample
+            GLuint ssao = graph.create("ssao", RenderTargetDesc(ssaoWidth, ssaoHeight, GL_RGBA16F, GL_RGBA, GL_FLOAT));
+            GLuint ssaoBlurredX = graph.create("ssaoBlurredX", RenderTargetDesc(ssaoWidth, ssaoHeight, GL_RGBA16F, GL_RGBA, GL_FLOAT));
+            GLuint ssaoBlurred = graph.create("ssaoBlurred", RenderTargetDesc(ssaoWidth, ssaoHeight, GL_RGBA16F, GL_RGBA, GL_FLOAT));
+            // bent normals are filtered bilinearly when upsampled, unlike the guides
+            const bool gtao = aoMethod == 1;
+            GLuint ssaoBentNormal = gtao ? graph.create("ssaoBentNormal", RenderTargetDesc(ssaoWidth, ssaoHeight, GL_RGB16F, GL_RGB, GL_FLOAT, GL_LINEAR)) : 0;
+            // the temporal accumulation persists across frames, so its targets are imported instead of pooled
+            const bool temporal = ssaoActive && ssaoTemporal;
+            if (temporal && (ssaoHistoryWidth != ssaoWidth || ssaoHistoryHeight != ssaoHeight))
+                ssaoHistoryInit(ssaoWidth, ssaoHeight);
+            GLuint ssaoAccumulated = ssao, ssaoPrevious = 0;
+            if (temporal)
+            {
+                ssaoPrevious = graph.import("ssaoHistory", ssaoHistory[ssaoFrame % 2], ssaoWidth, ssaoHeight);
+                ssaoAccumulated = graph.import("ssaoAccumulated", ssaoHistory[(ssaoFrame + 1) % 2], ssaoWidth, ssaoHeight);
+            }
+            // golden ratio and plastic number sequences: every frame turns the samples to directions the history lacks
+            // and, with a reduced kernel, picks another of its interleaved subsets
+            const glm::vec2 temporalOffset = temporal
+                ? glm::vec2((float)fmod(ssaoFrame * 0.618034, 1.0), (float)fmod(ssaoFrame * 0.754878, 1.0)) : glm::vec2(0.0f);
+
             // 1. Geometry Pass: render scene's geometry/color data into gbuffer
-            glBindFramebuffer(GL_FRAMEBUFFER, gBuffer);
-            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-            modelGeometryPass.Use();
-            modelGeometryPass.setMat4("projection", projection);
-            modelGeometryPass.setMat4("view", view);
-            modelGeometryPass.setBool("invertedNormals", 0);
-            // model
-            modelGeometryPass.setMat4("model", model);
-            ourModel.Draw(modelGeometryPass);
-            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+            GLuint geometry = graph.addPass("geometry", GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT, [&](const FrameGraph&)
+            {
+                Shader& geometryPass = modelGeometryPass.get(ssaoActive ? GEOMETRY_SSAO : 0);
+                geometryPass.Use();
+                geometryPass.setFloat("metallic", deferredMetallic);
+                geometryPass.setFloat("roughness", deferredRoughness);
+                // the albedo is stored sRGB encoded, more precision in the darks for the same 8 bits
+                glState.enable(GL_FRAMEBUFFER_SRGB);
+                // model
+                renderQueue.clear();
+                ourModel.Submit(renderQueue, RENDER_PASS_OPAQUE, geometryPass, nullptr, model, view, FAR_PLANE);
+                renderQueue.sort();
+                renderQueue.execute();
+                glState.disable(GL_FRAMEBUFFER_SRGB);
+            });
+            graph.write(geometry, gNormal);
+            graph.write(geometry, gAlbedo);
+            graph.write(geometry, gMaterial);
+            graph.write(geometry, gDepth);
+
+            // 2. downsample the gbuffer's depth and normal for a reduced resolution SSAO
+            if (ssaoScale > 1)
+            {
+                GLuint downsample = graph.addPass("ssao downsample", 0, [&](const FrameGraph& resources)
+                {
+                    ssaoDownsampleShader.Use();
+                    ssaoDownsampleShader.setInt("scale", ssaoScale);
+                    glState.activeTexture(GL_TEXTURE0);
+                    glState.bindTexture(GL_TEXTURE_2D, resources.texture(gDepth));
+                    glState.activeTexture(GL_TEXTURE1);
+                    glState.bindTexture(GL_TEXTURE_2D, resources.texture(gNormal));
+                    RenderQuad();
+                });
+                graph.read(downsample, gDepth);
+                graph.read(downsample, gNormal);
+                graph.write(downsample, ssaoDepth);
+                graph.write(downsample, ssaoNormal);
+            }
 
-            if (ssaoActive)
+            // 3. generate SSAO texture, with the hemisphere kernel or the GTAO horizon search
+            GLuint ssaoPass = graph.addPass(gtao ? "gtao" : "ssao", GL_COLOR_BUFFER_BIT, [&](const FrameGraph& resources)
             {
-                // 2. generate SSAO texture
-                glBindFramebuffer(GL_FRAMEBUFFER, ssaoFBO);
-                glClear(GL_COLOR_BUFFER_BIT);
-                ssaoShader.Use();
-                // Send kernel + rotation 
-                ssaoShader.setInt("kernelSize", kernelSize);
-                ssaoShader.setFloat("radius", ssaoRadius);
-                ssaoShader.setFloat("bias", ssaoBias);
-                ssaoShader.setInt("power", power);
-                for (GLuint i = 0; i < 64; ++i)
-                    ssaoShader.setVec3("samples[" + std::to_string(i) + "]", ssaoKernel[i]);
-                ssaoShader.setMat4("projection", projection);
-                glActiveTexture(GL_TEXTURE0);
-                glBindTexture(GL_TEXTURE_2D, gPosition);
-                glActiveTexture(GL_TEXTURE1);
-                glBindTexture(GL_TEXTURE_2D, gNormal);
-                glActiveTexture(GL_TEXTURE2);
-                glBindTexture(GL_TEXTURE_2D, noiseTexture);
+                Shader& occlusionShader = gtao ? gtaoShader : ssaoShader;
+                occlusionShader.Use();
+                if (gtao)
+                {
+                    occlusionShader.setInt("sliceCount", gtaoSlices);
+                    occlusionShader.setInt("stepCount", gtaoSteps);
+                }
+                else
+                {
+                    // Send kernel + rotation 
+                    occlusionShader.setInt("kernelSize", kernelSize);
+                }
+                occlusionShader.setFloat("radius", ssaoRadius);
+                occlusionShader.setFloat("bias", ssaoBias);
+                occlusionShader.setInt("power", power);
+                occlusionShader.setVec2("noiseScale", ssaoWidth / 4.0f, ssaoHeight / 4.0f);
+                occlusionShader.setVec2("temporalOffset", temporalOffset);
+                glState.activeTexture(GL_TEXTURE0);
+                glState.bindTexture(GL_TEXTURE_2D, resources.texture(ssaoDepth));
+                glState.activeTexture(GL_TEXTURE1);
+                glState.bindTexture(GL_TEXTURE_2D, resources.texture(ssaoNormal));
+                glState.activeTexture(GL_TEXTURE2);
+                glState.bindTexture(GL_TEXTURE_2D, resources.texture(ssaoNoise));
                 RenderQuad();
-                glBindFramebuffer(GL_FRAMEBUFFER, 0);
+            });
+            graph.read(ssaoPass, ssaoDepth);
+            graph.read(ssaoPass, ssaoNormal);
+            graph.read(ssaoPass, ssaoNoise);
+            graph.write(ssaoPass, ssao);
+            if (gtao)
+                graph.write(ssaoPass, ssaoBentNormal);
+
+            // 4. accumulate the occlusion over frames
+            if (temporal)
+            {
+                GLuint accumulate = graph.addPass("ssao temporal", 0, [&](const FrameGraph& resources)
+                {
+                    ssaoTemporalShader.Use();
+                    ssaoTemporalShader.setMat4("viewToPreviousView", ssaoPreviousView * glm::inverse(view));
+                    ssaoTemporalShader.setMat4("previousProjection", ssaoPreviousProjection);
+                    ssaoTemporalShader.setFloat("blend", ssaoHistoryValid ? ssaoTemporalBlend : 1.0f);
+                    glState.activeTexture(GL_TEXTURE0);
+                    glState.bindTexture(GL_TEXTURE_2D, resources.texture(ssao));
+                    glState.activeTexture(GL_TEXTURE1);
+                    glState.bindTexture(GL_TEXTURE_2D, resources.texture(ssaoPrevious));
+                    RenderQuad();
+                });
+                graph.read(accumulate, ssao);
+                graph.read(accumulate, ssaoPrevious);
+                graph.write(accumulate, ssaoAccumulated);
+            }
 
-                // 3. blur SSAO texture to remove noise
-                glBindFramebuffer(GL_FRAMEBUFFER, ssaoBlurFBO);
-                glClear(GL_COLOR_BUFFER_BIT);
+            // 5. blur SSAO texture to remove noise, horizontally then vertically, without crossing depth or normal edges
+            GLuint ssaoBlurX = graph.addPass("ssao blur x", 0, [&](const FrameGraph& resources)
+            {
                 ssaoBlurShader.Use();
-                glActiveTexture(GL_TEXTURE0);
-                glBindTexture(GL_TEXTURE_2D, ssaoColorBuffer);
+                ssaoBlurShader.setVec2("direction", 1.0f, 0.0f);
+                ssaoBlurShader.setInt("radius", ssaoBlurRadius);
+                glState.activeTexture(GL_TEXTURE0);
+                glState.bindTexture(GL_TEXTURE_2D, resources.texture(ssaoAccumulated));
                 RenderQuad();
-                glBindFramebuffer(GL_FRAMEBUFFER, 0);
-            }
-            
+            });
+            graph.read(ssaoBlurX, ssaoAccumulated);
+            graph.write(ssaoBlurX, ssaoBlurredX);
+            GLuint ssaoBlurY = graph.addPass("ssao blur y", 0, [&](const FrameGraph& resources)
+            {
+                ssaoBlurShader.Use();
+                ssaoBlurShader.setVec2("direction", 0.0f, 1.0f);
+                ssaoBlurShader.setInt("radius", ssaoBlurRadius);
+                glState.activeTexture(GL_TEXTURE0);
+                glState.bindTexture(GL_TEXTURE_2D, resources.texture(ssaoBlurredX));
+                RenderQuad();
+            });
+            graph.read(ssaoBlurY, ssaoBlurredX);
+            graph.write(ssaoBlurY, ssaoBlurred);
 
-            // 2. Lighting Pass: calculate lighting by iterating over a screen filled quad pixel-by-pixel using the gbuffer's content.
-            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-            modelLightingPass.Use();
-            // send light relevant uniforms
-            glm::vec3 lightPosView = glm::vec3(camera.GetViewMatrix() * glm::vec4(ssaoLightPos, 1.0));
-            modelLightingPass.setVec3("light.Position", lightPosView);
-            modelLightingPass.setVec3("light.Color", ssaoLightColor);
-            modelLightingPass.setVec3("viewPos", camera.Position);
-            // Update attenuation parameters
-            const float constant = 1.0; // note that we don't send this to the shader, we assume it is always 1.0 (in our case)
-            const float linear = 0.09;
-            const float quadratic = 0.032;
-            modelLightingPass.setFloat("light.Linear", linear);
-            modelLightingPass.setFloat("light.Quadratic", quadratic);
-            glActiveTexture(GL_TEXTURE0);
-            glBindTexture(GL_TEXTURE_2D, gPosition);
-            glActiveTexture(GL_TEXTURE1);
-            glBindTexture(GL_TEXTURE_2D, gNormal);
-            glActiveTexture(GL_TEXTURE2);
-            glBindTexture(GL_TEXTURE_2D, gAlbedo);
-            glActiveTexture(GL_TEXTURE3); // add extra SSAO texture to lighting pass
-            glBindTexture(GL_TEXTURE_2D, ssaoColorBufferBlur);
-            RenderQuad();
-
-            modelLightingPass.setBool("deferredActive", deferredActive);
-            modelLightingPass.setBool("ssaoActive", ssaoActive);
+            // 6. Lighting Pass: calculate lighting by iterating over a screen filled quad pixel-by-pixel using the gbuffer's content.
+            GLuint lighting = graph.addPass("lighting", GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT, [&](const FrameGraph& resources)
+            {
+                GLuint lightingFeatures = ssaoActive ? LIGHTING_SSAO : 0;
+                if (ssaoActive && ssaoScale > 1)
+                    lightingFeatures |= LIGHTING_SSAO_UPSAMPLE;
+                if (ssaoActive && gtao)
+                    lightingFeatures |= LIGHTING_SSAO_BENT_NORMALS;
+                if (clusteredLighting)
+                    lightingFeatures |= LIGHTING_CLUSTERED;
+                Shader& lightingPass = modelLightingPass.get(lightingFeatures);
+                lightingPass.Use();
+                if (clusteredLighting)
+                    clusteredLights.bind(lightingPass, 6);
+                // send light relevant uniforms
+                glm::vec3 lightPosView = glm::vec3(camera.GetViewMatrix() * glm::vec4(ssaoLightPos, 1.0));
+                lightingPass.setVec3("light.Position", lightPosView);
+                lightingPass.setVec3("light.Color", ssaoLightColor);
+                // Update attenuation parameters
+                const float constant = 1.0; // note that we don't send this to the shader, we assume it is always 1.0 (in our case)
+                const float linear = 0.09;
+                const float quadratic = 0.032;
+                lightingPass.setFloat("light.Linear", linear);
+                lightingPass.setFloat("light.Quadratic", quadratic);
+                glState.activeTexture(GL_TEXTURE0);
+                glState.bindTexture(GL_TEXTURE_2D, resources.texture(gDepth));
+                glState.activeTexture(GL_TEXTURE1);
+                glState.bindTexture(GL_TEXTURE_2D, resources.texture(gNormal));
+                glState.activeTexture(GL_TEXTURE2);
+                glState.bindTexture(GL_TEXTURE_2D, resources.texture(gAlbedo));
+                glState.activeTexture(GL_TEXTURE5);
+                glState.bindTexture(GL_TEXTURE_2D, resources.texture(gMaterial));
+                if (ssaoActive)
+                {
+                    glState.activeTexture(GL_TEXTURE3); // add extra SSAO texture to lighting pass
+                    glState.bindTexture(GL_TEXTURE_2D, resources.texture(ssaoBlurred));
+                    if (gtao)
+                    {
+                        glState.activeTexture(GL_TEXTURE4);
+                        glState.bindTexture(GL_TEXTURE_2D, resources.texture(ssaoBentNormal));
+                    }
+                }
+                RenderQuad();
+            });
+            graph.read(lighting, gDepth);
+            graph.read(lighting, gNormal);
+            graph.read(lighting, gAlbedo);
+            graph.read(lighting, gMaterial);
+            if (ssaoActive)
+                graph.read(lighting, ssaoBlurred);
+            if (ssaoActive && gtao)
+                graph.read(lighting, ssaoBentNormal);
+            graph.write(lighting, sceneColor);
+            ssaoHistoryWritten = temporal;
+
+            // 7. point lights added one bounding sphere at a time; the spheres are depth tested against a copy of the
+            // G-buffer's depth, which the lighting samples and so cannot be attached while it does
+            if (lightVolumes)
+            {
+                GLuint volumeDepth = graph.create("lightVolumeDepth", RenderTargetDesc(renderWidth, renderHeight, GL_DEPTH24_STENCIL8, GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8));
+                // names are literals and the lambdas capture by reference, the persistent graph stores both without allocating
+                GLuint depthCopy = graph.addPass("light volume depth", 0, [&](const FrameGraph& resources)
+                {
+                    // looking up the source may create its framebuffer and bind it, so the destination is bound again
+                    GLuint source = renderTargetPool.depthFramebuffer(resources.texture(gDepth), true);
+                    GLuint destination = renderTargetPool.depthFramebuffer(resources.texture(volumeDepth), true);
+                    glState.bindFramebuffer(GL_READ_FRAMEBUFFER, source);
+                    glState.bindFramebuffer(GL_DRAW_FRAMEBUFFER, destination);
+                    glBlitFramebuffer(0, 0, renderWidth, renderHeight, 0, 0, renderWidth, renderHeight, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+                });
+                graph.read(depthCopy, gDepth);
+                graph.write(depthCopy, volumeDepth);
+
+                GLuint volumes = graph.addPass("light volumes", GL_STENCIL_BUFFER_BIT, [&](const FrameGraph& resources)
+                {
+                    glState.activeTexture(GL_TEXTURE0);
+                    glState.bindTexture(GL_TEXTURE_2D, resources.texture(gDepth));
+                    glState.activeTexture(GL_TEXTURE1);
+                    glState.bindTexture(GL_TEXTURE_2D, resources.texture(gNormal));
+                    glState.activeTexture(GL_TEXTURE2);
+                    glState.bindTexture(GL_TEXTURE_2D, resources.texture(gAlbedo));
+                    glState.activeTexture(GL_TEXTURE5);
+                    glState.bindTexture(GL_TEXTURE_2D, resources.texture(gMaterial));
+                    renderLightVolumes(view);
+                });
+                graph.read(volumes, gDepth);
+                graph.read(volumes, gNormal);
+                graph.read(volumes, gAlbedo);
+                graph.read(volumes, gMaterial);
+                // read as well as written, so the graph keeps the passes before them
+                graph.read(volumes, sceneColor);
+                graph.read(volumes, volumeDepth);
+                graph.write(volumes, sceneColor);
+                graph.write(volumes, volumeDepth);
+            }
         }
         else if(forwardRendering)
         {
-            modelShader.Use();
-            // Draw the loaded model
-            modelShader.setVec3("cameraPos", camera.Position);
-            modelShader.setVec3("lightColor", lightColor.x, lightColor.y, lightColor.z);
-            if (lightMode == 1)
+            GLuint forward = graph.addPass("forward", sceneClear, [&](const FrameGraph&)
             {
-                modelShader.setVec3("lightPos", lightPos);
-                modelShader.setFloat("light.constant", 1.0);
-                modelShader.setFloat("light.linear", 0.09);
-                modelShader.setFloat("light.quadratic", 0.032);
-            }
-            if (lightMode == 2)
-                modelShader.setVec3("light.direction", -lightDirection);
-            modelShader.setInt("lightMode", lightMode);
-            modelShader.setVec3("viewPos", camera.Position);
-            modelShader.setVec3("material.ambient", ambientMaterial.x, ambientMaterial.y, ambientMaterial.z);
-            modelShader.setVec3("material.diffuse", diffuseMaterial.x, diffuseMaterial.y, diffuseMaterial.z);
-            modelShader.setVec3("material.specular", specularMaterial.x, specularMaterial.y, specularMaterial.z);
-            modelShader.setFloat("material.shininess", shineAmount);
-
-            // Transformation matrices
-            modelShader.setMat4("projection", projection);
-            modelShader.setMat4("view", view);
-            modelShader.setMat4("model", model);
-            
-            ourModel.Draw(modelShader);
-
-            // Draw skybox as last
-            glDepthFunc(GL_LEQUAL);  // Change depth function so depth test passes when values are equal to depth buffer's content
-            skyboxShader.Use();
-            view = glm::mat4(glm::mat3(camera.GetViewMatrix()));	// Remove any translation component of the view matrix
-            glUniformMatrix4fv(glGetUniformLocation(skyboxShader.Program, "view"), 1, GL_FALSE, glm::value_ptr(view));
-            glUniformMatrix4fv(glGetUniformLocation(skyboxShader.Program, "projection"), 1, GL_FALSE, glm::value_ptr(projection));
-            // skybox cube
-            glBindVertexArray(skyboxVAO);
-            glActiveTexture(GL_TEXTURE0);
-            glUniform1i(glGetUniformLocation(modelShader.Program, "skybox"), 0);
-            glBindTexture(GL_TEXTURE_CUBE_MAP, cubemapTexture);
-            glDrawArrays(GL_TRIANGLES, 0, 36);
-            glBindVertexArray(0);
-            glDepthFunc(GL_LESS);
+                Shader& forwardShader = modelShader.get(lightMode == 2 ? FORWARD_DIRECTIONAL_LIGHT : 0);
+                forwardShader.Use();
+                // Draw the loaded model
+                forwardShader.setVec3("lightColor", lightColor.x, lightColor.y, lightColor.z);
+                if (lightMode == 1)
+                {
+                    forwardShader.setVec3("lightPos", lightPos);
+                    forwardShader.setFloat("light.constant", 1.0);
+                    forwardShader.setFloat("light.linear", 0.09);
+                    forwardShader.setFloat("light.quadratic", 0.032);
+                }
+                if (lightMode == 2)
+                    forwardShader.setVec3("light.direction", -lightDirection);
+                forwardShader.setVec3("material.ambient", ambientMaterial.x, ambientMaterial.y, ambientMaterial.z);
+                forwardShader.setVec3("material.diffuse", diffuseMaterial.x, diffuseMaterial.y, diffuseMaterial.z);
+                forwardShader.setVec3("material.specular", specularMaterial.x, specularMaterial.y, specularMaterial.z);
+                forwardShader.setFloat("material.shininess", shineAmount);
+
+                // Transformation matrices are set per draw by the queue
+                renderQueue.clear();
+                ourModel.Submit(renderQueue, RENDER_PASS_OPAQUE, forwardShader, nullptr, model, view, FAR_PLANE);
+                renderQueue.sort();
+                renderQueue.execute();
+
+                // Draw skybox as last
+                profiler.begin("skybox");
+                glState.depthFunc(GL_LEQUAL);  // Change depth function so depth test passes when values are equal to depth buffer's content
+                skyboxShader.Use();
+                // skybox cube
+                glState.bindVertexArray(skyboxVAO);
+                glState.activeTexture(GL_TEXTURE0);
+                skyboxShader.setInt("skybox", 0);
+                glState.bindTexture(GL_TEXTURE_CUBE_MAP, cubemapTexture);
+                glDrawArrays(GL_TRIANGLES, 0, 36);
+                glState.depthFunc(GL_LESS);
+                profiler.end();
+            });
+            graph.write(forward, sceneColor);
+            if (offscreen)
+                graph.write(forward, sceneDepth);
+        }
+
+        // the scaled scene stretched over the backbuffer and sharpened, before ImGui draws over it; a copy at full scale
+        if (offscreen && (pbrActive || deferredRendering || forwardRendering))
+        {
+            GLuint upscalePass = graph.addPass("upscale", 0, [&](const FrameGraph& resources)
+            {
+                glState.disable(GL_DEPTH_TEST);
+                upscaleShader.Use();
+                upscaleShader.setFloat("sharpness", upscale ? upscaleSharpness : 0.0f);
+                glState.activeTexture(GL_TEXTURE0);
+                glState.bindTexture(GL_TEXTURE_2D, resources.texture(sceneColor));
+                RenderQuad();
+                glState.enable(GL_DEPTH_TEST);
+            });
+            graph.read(upscalePass, sceneColor);
+            graph.write(upscalePass, backbuffer);
+        }
+
+        graph.compile();
+        profiler.begin("scene");
+        graph.execute();
+        profiler.end();
+        dynamicResolution.endFrame();
+        fixScreenSize(window);
 
+        // the accumulation just written is next frame's history, seen from this frame's camera
+        ssaoHistoryValid = ssaoHistoryWritten;
+        if (ssaoHistoryWritten)
+        {
+            ssaoPreviousView = view;
+            ssaoPreviousProjection = projection;
+            ++ssaoFrame;
         }
         
         // Rendering
+        profiler.begin("imgui");
         ImGui::Render();
+        profiler.end();
+        // the ImGui renderer binds its own program, buffers and font texture
+        glState.invalidate();
+        profiler.endFrame();
 
         // Swap the buffers
         glfwSwapBuffers(window);
+
+        frameAllocations = heapAllocations - frameStartAllocations;
+        glState.endFrame();
+        renderTargetPool.endFrame();
     }
 
-    glfwTerminate();
+    shutdown();
     return 0;
 }
 
+void shutdown()
+{
+    noiseTexture.release();
+    ssaoHistory[0].release();
+    ssaoHistory[1].release();
+    envCubemap.release();
+    irradianceSourceCubemap.release();
+    captureFBO.release();
+    captureRBO.release();
+    irradianceMap.release();
+    prefilterMap.release();
+    renderTargetPool.clear();
+    // the handles owned by the other globals (textures, probes, uniform blocks) go with the context
+    GLContext::contextDestroyed();
+    glfwTerminate();
+}
+
 
 void guiSetup()
 {
     // GUI positioning
     int offset = 10;
-    ImGui::SetWindowSize(ImVec2(guiWidth, SCREEN_WIDTH - 20));
+    ImGui::SetWindowSize(ImVec2(guiWidth, SCREEN_HEIGHT - 20));
     ImGui::SetWindowPos(ImVec2(SCREEN_WIDTH - guiWidth - offset, 0 + offset));
     
     // Scene Setup
@@ -643,6 +1162,55 @@ void guiSetup()
                 cubemapTexture = cubemap.configureSkybox(skyboxPath);
             }
 
+            ImGui::TreePop();
+        }
+        if (ImGui::TreeNode("Reflection Probes"))
+        {
+            // Probes are refreshed one cubemap face per frame
+            ImGui::Checkbox("Enabled", &reflectionProbes.enabled);
+            ImGui::Text("Probes: %d / %d", (int)reflectionProbes.probes.size(), (int)ReflectionProbes::MAX_PROBES);
+
+            ImGui::TreePop();
+        }
+        if (ImGui::TreeNode("Environment"))
+        {
+            // IBL environments found in the image folders
+            for (size_t i = 0; i < environmentRegistry.environments.size(); i++)
+            {
+                if (ImGui::Selectable(environmentRegistry.environments[i].name.c_str(), currentEnvironment == (int)i))
+                    loadEnvironment((int)i);
+            }
+
+            ImGui::TreePop();
+        }
+    }
+    // Per frame counters of the render loop
+    if (ImGui::CollapsingHeader("Frame Statistics", 0))
+    {
+        ImGui::Text("Heap allocations: %llu", frameAllocations);
+        ImGui::Text("GL state calls: %u issued, %u skipped", glState.frameStatistics().issued, glState.frameStatistics().skipped);
+        const RenderQueue::Statistics& queueStatistics = renderQueue.statistics();
+        ImGui::Text("Render queue: %u draws, %u programs, %u materials, %u VAOs", queueStatistics.draws, queueStatistics.programs,
+                    queueStatistics.materials, queueStatistics.vertexArrays);
+    }
+    // CPU and GPU time of each pass
+    if (ImGui::CollapsingHeader("Profiler", 0))
+    {
+        profilerGui();
+    }
+    // GPU memory held by textures and renderbuffers
+    if (ImGui::CollapsingHeader("GPU Memory", 0))
+    {
+        ImGui::Text("Total: %.2f MB", GpuMemory::totalBytes() / (1024.0f * 1024.0f));
+        ImGui::Text("Objects: %d", (int)GpuMemory::allocations().size());
+        ImGui::Text("Pooled render targets: %d", (int)renderTargetPool.targetCount());
+        ImGui::Text("G-buffer traffic: %.1f MB per frame", gBufferTraffic(gBufferLayout(SCREEN_WIDTH, SCREEN_HEIGHT, false)) / (1024.0f * 1024.0f));
+        if (ImGui::TreeNode("Allocations"))
+        {
+            std::map<unsigned long long, GpuMemory::Allocation>::const_iterator it;
+            for (it = GpuMemory::allocations().begin(); it != GpuMemory::allocations().end(); ++it)
+                ImGui::Text("%-24s %8.2f MB", it->second.label.c_str(), it->second.bytes / (1024.0f * 1024.0f));
+
             ImGui::TreePop();
         }
     }
@@ -732,11 +1300,61 @@ void guiSetup()
                 ssaoActive = false;
             }
 
-            ImGui::SliderInt("Kernel Size", &kernelSize, 1, 128);
+            ImGui::Combo("Method", &aoMethod, "Hemisphere\0GTAO\0");
+            ImGui::Combo("Resolution", &ssaoResolution, "Full\0Half\0Quarter\0");
+            if (aoMethod == 1)
+            {
+                ImGui::SliderInt("Slices", &gtaoSlices, 1, 8);
+                ImGui::SliderInt("Steps", &gtaoSteps, 1, 16);
+            }
+            else
+            {
+                ImGui::SliderInt("Kernel Size", &kernelSize, 1, 64);
+            }
             ImGui::SliderFloat("Radius", &ssaoRadius, 0.0, 1.0);
             ImGui::SliderFloat("Bias", &ssaoBias, 0.0, 1.0);
+            ImGui::SliderInt("Blur Radius", &ssaoBlurRadius, 0, 8);
+            ImGui::Checkbox("Temporal Accumulation", &ssaoTemporal);
+            if (ssaoTemporal)
+                ImGui::SliderFloat("Temporal Blend", &ssaoTemporalBlend, 0.02f, 1.0f);
             ImGui::SliderInt("Power", &power, 1, 10);
 
+            ImGui::TreePop();
+        }
+        if (ImGui::TreeNode("G-Buffer Material"))
+        {
+            ImGui::SliderFloat("Metallic", &deferredMetallic, 0.0f, 1.0f);
+            ImGui::SliderFloat("Roughness", &deferredRoughness, 0.05f, 1.0f);
+
+            ImGui::TreePop();
+        }
+        if (ImGui::TreeNode("Clustered Lights"))
+        {
+            ImGui::Checkbox("Enabled", &clusteredLights.enabled);
+            bool changed = ImGui::SliderInt("Count", &clusteredLightCount, 0, 2048);
+            changed |= ImGui::SliderFloat("Radius", &clusteredLightRadius, 0.5f, 10.0f);
+            changed |= ImGui::SliderFloat("Intensity", &clusteredLightIntensity, 0.0f, 20.0f);
+            if (changed)
+                clusteredLightsInit(clusteredLightCount, clusteredLightRadius, clusteredLightIntensity);
+            ImGui::Text("%u list entries, %u in the longest list", clusteredLights.listEntries(), clusteredLights.longestList());
+            // the deferred path adds them one bounding sphere at a time instead of looping over the clusters
+            ImGui::Checkbox("Light Volumes (deferred)", &deferredLightVolumes);
+
+            ImGui::TreePop();
+        }
+        if (ImGui::TreeNode("Dynamic Resolution"))
+        {
+            ImGui::Checkbox("Enabled", &dynamicResolution.enabled);
+            ImGui::SliderFloat("Target (ms)", &dynamicResolution.targetMs, 4.0f, 33.0f);
+            ImGui::SliderFloat("Min Scale", &dynamicResolution.minScale, 0.25f, 1.0f);
+            ImGui::SliderFloat("Max Scale", &dynamicResolution.maxScale, 0.25f, 1.0f);
+            if (dynamicResolution.maxScale < dynamicResolution.minScale)
+                dynamicResolution.maxScale = dynamicResolution.minScale;
+            ImGui::SliderFloat("Sharpness", &upscaleSharpness, 0.0f, 1.0f);
+            float scale = dynamicResolution.scale();
+            ImGui::Text("GPU %.2f ms, scale %.2f (%dx%d)", dynamicResolution.gpuTime(), scale,
+                        (int)(SCREEN_WIDTH * scale + 0.5f), (int)(SCREEN_HEIGHT * scale + 0.5f));
+
             ImGui::TreePop();
         }
     }
@@ -796,34 +1414,6 @@ void guiSetup()
             ImGui::TreePop();
         }
 
-        if (ImGui::TreeNode("Environments"))
-        {
-            if (ImGui::Button("Newport Loft"))
-            {
-                hdrTexture = envHDR.loadHDR("images/loft/Newport_Loft_Ref_Flip.hdr", "loft");
-                pbrInit();
-            }
-            if (ImGui::Button("Industrial Hall"))
-            {
-                hdrTexture = envHDR.loadHDR("images/industrial-hall/industrial_Ref_Flip.hdr", "industrial");
-                pbrInit();
-            }
-            if (ImGui::Button("Winter Forest"))
-            {
-                hdrTexture = envHDR.loadHDR("images/winter-forest/WinterForest_Ref_Flip.hdr", "forest");
-                pbrInit();
-            }
-            if (ImGui::Button("City Night"))
-            {
-                hdrTexture = envHDR.loadHDR("images/city-night/CityNight_Ref_Flip.hdr", "city");
-                pbrInit();
-            }
-
-            fixScreenSize(window);
-
-            ImGui::TreePop();
-        }
-
     }
     // About
     if (ImGui::CollapsingHeader("About", 0))
@@ -847,77 +1437,123 @@ void guiSetup()
     */
 }
 
-void gBufferInit()
+// Draws the scopes of a profiled frame as nested bars, one row per depth, scaled to the frame scope
+void profilerFlame(const Profiler::Frame& frame, bool gpu)
 {
-    glGenFramebuffers(1, &gBuffer);
-    glBindFramebuffer(GL_FRAMEBUFFER, gBuffer);
-    // position color buffer
-    glGenTextures(1, &gPosition);
-    glBindTexture(GL_TEXTURE_2D, gPosition);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16F, SCREEN_WIDTH, SCREEN_HEIGHT, 0, GL_RGB, GL_FLOAT, NULL);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, gPosition, 0);
-    // normal color buffer
-    glGenTextures(1, &gNormal);
-    glBindTexture(GL_TEXTURE_2D, gNormal);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16F, SCREEN_WIDTH, SCREEN_HEIGHT, 0, GL_RGB, GL_FLOAT, NULL);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, gNormal, 0);
-    // color + specular color buffer
-    glGenTextures(1, &gAlbedo);
-    glBindTexture(GL_TEXTURE_2D, gAlbedo);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, SCREEN_WIDTH, SCREEN_HEIGHT, 0, GL_RGB, GL_UNSIGNED_BYTE, NULL);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT2, GL_TEXTURE_2D, gAlbedo, 0);
-    // tell OpenGL which color attachments we'll use (of this framebuffer) for rendering 
-    GLuint attachments[3] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2 };
-    glDrawBuffers(3, attachments);
-    // create and attach depth buffer (renderbuffer)
-    GLuint rboDepth;
-    glGenRenderbuffers(1, &rboDepth);
-    glBindRenderbuffer(GL_RENDERBUFFER, rboDepth);
-    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT, SCREEN_WIDTH, SCREEN_HEIGHT);
-    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, rboDepth);
-    // finally check if framebuffer is complete
-    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
-        std::cout << "Framebuffer not complete!" << std::endl;
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    const float rowHeight = ImGui::GetTextLineHeight() + 4.0f;
+    double total = gpu ? frame.scopes[0].gpuDuration : frame.scopes[0].cpuDuration;
+    if (total <= 0.0)
+    {
+        ImGui::Text("No timings");
+        return;
+    }
 
+    ImDrawList* drawList = ImGui::GetWindowDrawList();
+    ImVec2 origin = ImGui::GetCursorScreenPos();
+    float width = ImGui::GetContentRegionAvailWidth();
+    GLuint maxDepth = 0;
+    for (size_t i = 0; i < frame.scopes.size(); ++i)
+    {
+        const Profiler::Scope& scope = frame.scopes[i];
+        double start = gpu ? scope.gpuStart : scope.cpuStart;
+        double duration = gpu ? scope.gpuDuration : scope.cpuDuration;
+        maxDepth = scope.depth > maxDepth ? scope.depth : maxDepth;
+
+        ImVec2 min(origin.x + (float)(start / total) * width, origin.y + scope.depth * rowHeight);
+        ImVec2 max(min.x + std::max(1.0f, (float)(duration / total) * width), min.y + rowHeight - 1.0f);
+        // the color only depends on the name, so a pass keeps its color from frame to frame
+        ImU32 color = IM_COL32(70 + (scope.name * 53) % 150, 70 + (scope.name * 97) % 150, 150, 255);
+        drawList->AddRectFilled(min, max, color);
+        const std::string& name = profiler.name(scope.name);
+        if (ImGui::CalcTextSize(name.c_str()).x < max.x - min.x - 4.0f)
+            drawList->AddText(ImVec2(min.x + 2.0f, min.y + 2.0f), IM_COL32_WHITE, name.c_str());
+        if (ImGui::IsMouseHoveringRect(min, max))
+            ImGui::SetTooltip("%s: %.3f ms", name.c_str(), duration);
+    }
+    ImGui::Dummy(ImVec2(width, (maxDepth + 1) * rowHeight));
 }
 
-void ssaoInit()
+void profilerGui()
 {
-    glGenFramebuffers(1, &ssaoFBO);  glGenFramebuffers(1, &ssaoBlurFBO);
-    glBindFramebuffer(GL_FRAMEBUFFER, ssaoFBO);
-    // SSAO color buffer
-    glGenTextures(1, &ssaoColorBuffer);
-    glBindTexture(GL_TEXTURE_2D, ssaoColorBuffer);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RED, SCREEN_WIDTH, SCREEN_HEIGHT, 0, GL_RGB, GL_FLOAT, NULL);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, ssaoColorBuffer, 0);
-    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
-        std::cout << "SSAO Framebuffer not complete!" << std::endl;
-    // and blur stage
-    glBindFramebuffer(GL_FRAMEBUFFER, ssaoBlurFBO);
-    glGenTextures(1, &ssaoColorBufferBlur);
-    glBindTexture(GL_TEXTURE_2D, ssaoColorBufferBlur);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RED, SCREEN_WIDTH, SCREEN_HEIGHT, 0, GL_RGB, GL_FLOAT, NULL);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, ssaoColorBufferBlur, 0);
-    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
-        std::cout << "SSAO Blur Framebuffer not complete!" << std::endl;
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    ImGui::Checkbox("Enabled", &profiler.enabled);
+    ImGui::SameLine();
+    if (ImGui::Button("Save Chrome trace"))
+        profiler.writeChromeTrace("profile.json");
+
+    GLuint frameCount = profiler.frameCount();
+    if (frameCount == 0)
+        return;
+    const Profiler::Frame& latest = profiler.latestFrame();
+
+    // one row per scope name of the latest frame, a name recorded several times in a frame adds up
+    ImGui::Columns(3, "profilerScopes");
+    ImGui::Text("Scope");
+    ImGui::NextColumn();
+    ImGui::Text("CPU ms min/avg/max");
+    ImGui::NextColumn();
+    ImGui::Text("GPU ms min/avg/max");
+    ImGui::NextColumn();
+    ImGui::Separator();
+    for (size_t i = 0; i < latest.scopes.size(); ++i)
+    {
+        GLuint name = latest.scopes[i].name;
+        bool listed = false;
+        for (size_t j = 0; j < i; ++j)
+            listed = listed || latest.scopes[j].name == name;
+        if (listed)
+            continue;
+
+        double cpuMin = 1e9, cpuMax = 0.0, cpuSum = 0.0, gpuMin = 1e9, gpuMax = 0.0, gpuSum = 0.0;
+        GLuint gpuFrames = 0;
+        for (GLuint f = 0; f < frameCount; ++f)
+        {
+            const Profiler::Frame& frame = profiler.frame(f);
+            double cpu = 0.0, gpu = 0.0;
+            bool gpuValid = true;
+            for (size_t j = 0; j < frame.scopes.size(); ++j)
+            {
+                if (frame.scopes[j].name != name)
+                    continue;
+                cpu += frame.scopes[j].cpuDuration;
+                gpu += frame.scopes[j].gpuDuration;
+                gpuValid = gpuValid && frame.scopes[j].gpuDuration >= 0.0;
+            }
+            cpuMin = std::min(cpuMin, cpu);
+            cpuMax = std::max(cpuMax, cpu);
+            cpuSum += cpu;
+            if (gpuValid)
+            {
+                gpuMin = std::min(gpuMin, gpu);
+                gpuMax = std::max(gpuMax, gpu);
+                gpuSum += gpu;
+                ++gpuFrames;
+            }
+        }
+
+        ImGui::Text("%*s%s", latest.scopes[i].depth * 2, "", profiler.name(name).c_str());
+        ImGui::NextColumn();
+        ImGui::Text("%.3f / %.3f / %.3f", cpuMin, cpuSum / frameCount, cpuMax);
+        ImGui::NextColumn();
+        if (gpuFrames > 0)
+            ImGui::Text("%.3f / %.3f / %.3f", gpuMin, gpuSum / gpuFrames, gpuMax);
+        else
+            ImGui::Text("-");
+        ImGui::NextColumn();
+    }
+    ImGui::Columns(1);
+
+    ImGui::Text("CPU");
+    profilerFlame(latest, false);
+    ImGui::Text("GPU");
+    profilerFlame(latest, true);
+}
 
+void ssaoInit()
+{
     // generate sample kernel
     std::uniform_real_distribution<GLfloat> randomFloats(0.0, 1.0); // generates random floats between 0.0 and 1.0
     std::default_random_engine generator;
+    ssaoKernel.clear();
     for (GLuint i = 0; i < 64; ++i)
     {
         glm::vec3 sample(randomFloats(generator) * 2.0 - 1.0, randomFloats(generator) * 2.0 - 1.0, randomFloats(generator));
@@ -931,6 +1567,12 @@ void ssaoInit()
         ssaoKernel.push_back(sample);
     }
 
+    // the kernel never changes, upload it once as std140 vec4s
+    SsaoKernelBlock kernelBlock;
+    for (GLuint i = 0; i < 64; ++i)
+        kernelBlock.samples[i] = glm::vec4(ssaoKernel[i], 0.0f);
+    ssaoKernelBlock.update(kernelBlock);
+
     // generate noise texture
     std::vector<glm::vec3> ssaoNoise;
     for (GLuint i = 0; i < 16; i++)
@@ -938,9 +1580,10 @@ void ssaoInit()
         glm::vec3 noise(randomFloats(generator) * 2.0 - 1.0, randomFloats(generator) * 2.0 - 1.0, 0.0f); // rotate around z-axis (in tangent space)
         ssaoNoise.push_back(noise);
     }
-    glGenTextures(1, &noiseTexture);
-    glBindTexture(GL_TEXTURE_2D, noiseTexture);
+    noiseTexture.create("ssao noise");
+    glState.bindTexture(GL_TEXTURE_2D, noiseTexture);
     glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB32F, 4, 4, 0, GL_RGB, GL_FLOAT, &ssaoNoise[0]);
+    noiseTexture.setMemory(GpuMemory::textureBytes(GL_RGB32F, 4, 4));
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
@@ -948,26 +1591,662 @@ void ssaoInit()
 }
 
 
-void pbrInit()
+void ssaoHistoryInit(GLsizei width, GLsizei height)
+{
+    // the names are kept: the frame graph's framebuffers attach them
+    for (int i = 0; i < 2; ++i)
+    {
+        if (ssaoHistory[i] == 0)
+            ssaoHistory[i].create(i == 0 ? "ssao history 0" : "ssao history 1");
+        glState.bindTexture(GL_TEXTURE_2D, ssaoHistory[i]);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, width, height, 0, GL_RGBA, GL_FLOAT, NULL);
+        ssaoHistory[i].setMemory(GpuMemory::textureBytes(GL_RGBA16F, width, height));
+        // reprojected texture coordinates fall between texels
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    }
+    ssaoHistoryWidth = width;
+    ssaoHistoryHeight = height;
+    ssaoHistoryValid = false;
+}
+
+void clusteredLightsInit(int count, float radius, float intensity)
+{
+    std::uniform_real_distribution<GLfloat> randomFloats(0.0, 1.0);
+    std::default_random_engine generator;
+    clusteredLights.lights.resize(count);
+    for (int i = 0; i < count; ++i)
+    {
+        PointLight& light = clusteredLights.lights[i];
+        // in a box around the model and the PBR spheres
+        GLfloat x = randomFloats(generator), y = randomFloats(generator), z = randomFloats(generator);
+        light.position = glm::vec3(lerp(-8.0f, 8.0f, x), lerp(-3.0f, 5.0f, y), lerp(-8.0f, 8.0f, z));
+        light.radius = radius * lerp(0.5f, 1.0f, randomFloats(generator));
+        // saturated colors: one channel full, the others random
+        glm::vec3 color(randomFloats(generator), randomFloats(generator), randomFloats(generator));
+        color[i % 3] = 1.0f;
+        light.color = color * intensity;
+    }
+}
+
+void loadShaders()
+{
+    // submitted together so the driver can compile them in parallel
+    ShaderBatch batch;
+    batch.add(gridShader, "shaders/gridTexture.vert", "shaders/gridTexture.frag");
+    batch.add(lightSource, "shaders/lightSource.vert", "shaders/lightSource.frag");
+    batch.add(modelReflection, "shaders/model_reflection.vert", "shaders/model_reflection.frag");
+    batch.add(skyboxShader, "shaders/skybox.vert", "shaders/skybox.frag");
+    batch.add(floorShader, "shaders/floorShader.vert", "shaders/floorShader.frag");
+    batch.add(ssaoShader, "shaders/model_lighting.vert", "shaders/ssaoShader.frag");
+    batch.add(gtaoShader, "shaders/model_lighting.vert", "shaders/gtaoShader.frag");
+    batch.add(ssaoBlurShader, "shaders/model_lighting.vert", "shaders/ssaoBlur.frag");
+    batch.add(ssaoDownsampleShader, "shaders/model_lighting.vert", "shaders/ssaoDownsample.frag");
+    batch.add(ssaoTemporalShader, "shaders/model_lighting.vert", "shaders/ssaoTemporal.frag");
+    batch.add(upscaleShader, "shaders/model_lighting.vert", "shaders/upscale.frag");
+    batch.add(lightVolumeShader, "shaders/lightVolume.vert", "shaders/lightVolume.frag");
+    batch.add(lightVolumeStencilShader, "shaders/lightVolume.vert", "shaders/lightVolumeStencil.frag");
+    // the multiple scattering energy compensation needs the Eavg channel of a three channel LUT
+    std::vector<std::string> pbrDefines;
+    if (brdfLUT.texInternalFormat == GL_RGB16F)
+        pbrDefines.push_back("MULTISCATTER");
+    batch.add(pbrShader, "shaders/pbrShader.vert", "shaders/pbrShader.frag", pbrDefines);
+    batch.add(rectToCubemap, "shaders/rectToCubemap.vert", "shaders/rectToCubemap.frag");
+    batch.add(irradianceShader, "shaders/rectToCubemap.vert", "shaders/pbrIrradiance.frag");
+    batch.add(prefilterShader, "shaders/rectToCubemap.vert", "shaders/prefilter.frag");
+    batch.add(backgroundShader, "shaders/background.vert", "shaders/background.frag");
+
+    // every permutation the GUI can switch to
+    modelShader.init("shaders/model_loading.vert", "shaders/model_loading.frag", { "DIRECTIONAL_LIGHT" });
+    modelShader.preload(batch, 0);
+    modelShader.preload(batch, FORWARD_DIRECTIONAL_LIGHT);
+    modelGeometryPass.init("shaders/model_geometry.vert", "shaders/model_geometry.frag", { "SSAO", "INVERTED_NORMALS" });
+    modelGeometryPass.preload(batch, 0);
+    modelGeometryPass.preload(batch, GEOMETRY_SSAO);
+    modelLightingPass.init("shaders/model_lighting.vert", "shaders/model_lighting.frag",
+                           { "SSAO", "SSAO_UPSAMPLE", "SSAO_BENT_NORMALS", "CLUSTERED_LIGHTS", "CLUSTERED_LIGHTS_NAIVE" });
+    const GLuint lightingVariants[] = { 0, LIGHTING_SSAO, LIGHTING_SSAO | LIGHTING_SSAO_UPSAMPLE, LIGHTING_SSAO | LIGHTING_SSAO_BENT_NORMALS,
+                                        LIGHTING_SSAO | LIGHTING_SSAO_UPSAMPLE | LIGHTING_SSAO_BENT_NORMALS };
+    for (size_t i = 0; i < sizeof(lightingVariants) / sizeof(lightingVariants[0]); ++i)
+    {
+        modelLightingPass.preload(batch, lightingVariants[i]);
+        modelLightingPass.preload(batch, lightingVariants[i] | LIGHTING_CLUSTERED);
+    }
+    batch.load();
+}
+
+void configureShaderConstants()
+{
+    // uniform locations may move when a program is rebuilt
+    pbrLightPositionsUniform = pbrShader.getUniform("lightPositions");
+    pbrLightColorsUniform = pbrShader.getUniform("lightColors");
+    lightVolumeModelUniform = lightVolumeShader.getUniform("model");
+    lightVolumeStencilModelUniform = lightVolumeStencilShader.getUniform("model");
+    lightVolumePositionUniform = lightVolumeShader.getUniform("lightPosition");
+    lightVolumeRadiusUniform = lightVolumeShader.getUniform("lightRadius");
+    lightVolumeColorUniform = lightVolumeShader.getUniform("lightColor");
+}
+
+void benchmarkShaderLoading()
+{
+    ShaderBinaryCache& cache = Shader::binaryCache();
+
+    // cold: every program compiled and linked, refreshing the cache entries
+    cache.readEnabled = false;
+    cache.resetStatistics();
+    double start = glfwGetTime();
+    loadShaders();
+    glFinish();
+    double cold = glfwGetTime() - start;
+    unsigned int compiled = cache.misses;
+
+    // warm: every program restored from the entries written above
+    cache.readEnabled = true;
+    cache.resetStatistics();
+    start = glfwGetTime();
+    loadShaders();
+    glFinish();
+    double warm = glfwGetTime() - start;
+
+    std::cout << "SHADER BENCHMARK - cold : " << cold * 1000.0 << " ms, " << compiled << " programs compiled" << std::endl;
+    std::cout << "SHADER BENCHMARK - warm : " << warm * 1000.0 << " ms, " << cache.hits << " programs from cache, "
+              << cache.misses + cache.rejected << " compiled" << std::endl;
+}
+
+GBufferLayout gBufferLayout(GLsizei width, GLsizei height, bool legacy)
+{
+    GBufferLayout layout;
+    if (legacy)
+    {
+        layout.targets[0] = RenderTargetDesc(width, height, GL_DEPTH_COMPONENT24, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT);
+        // view space position, normal, albedo
+        layout.targets[1] = RenderTargetDesc(width, height, GL_RGB16F, GL_RGB, GL_FLOAT);
+        layout.targets[2] = RenderTargetDesc(width, height, GL_RGB16F, GL_RGB, GL_FLOAT);
+        layout.targets[3] = RenderTargetDesc(width, height, GL_RGB8, GL_RGB, GL_UNSIGNED_BYTE);
+    }
+    else
+    {
+        // depth and stencil, 4 bytes like the depth alone; depth blits need the light volumes' copy in the same format
+        layout.targets[0] = RenderTargetDesc(width, height, GL_DEPTH24_STENCIL8, GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8);
+        // octahedral normal, albedo and occlusion, metallic/roughness/specular/flags
+        layout.targets[1] = RenderTargetDesc(width, height, GL_RG16, GL_RG, GL_UNSIGNED_SHORT);
+        layout.targets[2] = RenderTargetDesc(width, height, GL_SRGB8_ALPHA8, GL_RGBA, GL_UNSIGNED_BYTE);
+        layout.targets[3] = RenderTargetDesc(width, height, GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE);
+    }
+    return layout;
+}
+
+GLsizeiptr gBufferTraffic(const GBufferLayout& layout)
+{
+    // the driver may pad 3 component formats to 4, the estimate uses the nominal sizes
+    GLsizeiptr bytes = 0;
+    for (int i = 0; i < GBufferLayout::TARGETS; ++i)
+        bytes += 2 * GpuMemory::textureBytes(layout.targets[i].internalFormat, layout.targets[i].width, layout.targets[i].height);
+    return bytes;
+}
+
+void benchmarkGBuffer()
+{
+    const int ITERATIONS = 100;
+    const GLsizei resolutions[2][2] = { { 1920, 1080 }, { 3840, 2160 } };
+
+    // stand-ins of the geometry and lighting passes: every target written then read once per pixel
+    Shader writeShader, readShader;
+    writeShader.loadShader("shaders/model_lighting.vert", "shaders/gbufferBenchmark.frag");
+    readShader.loadShader("shaders/model_lighting.vert", "shaders/gbufferBenchmarkRead.frag");
+    readShader.Use();
+    readShader.setSampler("target0", 0);
+    readShader.setSampler("target1", 1);
+    readShader.setSampler("target2", 2);
+    readShader.setSampler("target3", 3);
+
+    GLuint query;
+    glGenQueries(1, &query);
+    glState.depthFunc(GL_ALWAYS);
+    for (int resolution = 0; resolution < 2; ++resolution)
+    {
+        const GLsizei width = resolutions[resolution][0], height = resolutions[resolution][1];
+        for (int legacy = 1; legacy >= 0; --legacy)
+        {
+            GBufferLayout layout = gBufferLayout(width, height, legacy != 0);
+            GLuint textures[GBufferLayout::TARGETS];
+            for (int i = 0; i < GBufferLayout::TARGETS; ++i)
+                textures[i] = renderTargetPool.acquire(layout.targets[i], "gbuffer benchmark");
+            GLuint output = renderTargetPool.acquire(RenderTargetDesc(width, height, GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE), "gbuffer benchmark output");
+            GLuint gBufferFBO = renderTargetPool.framebuffer(std::vector<GLuint>(textures + 1, textures + GBufferLayout::TARGETS), textures[0], false);
+            GLuint outputFBO = renderTargetPool.framebuffer(std::vector<GLuint>(1, output), 0, false);
+            glViewport(0, 0, width, height);
+
+            // one untimed iteration so allocations and first use costs are out of the measure
+            for (int iteration = -1; iteration < ITERATIONS; ++iteration)
+            {
+                if (iteration == 0)
+                {
+                    glFinish();
+                    glBeginQuery(GL_TIME_ELAPSED, query);
+                }
+                glState.bindFramebuffer(GL_FRAMEBUFFER, gBufferFBO);
+                glState.enable(GL_DEPTH_TEST);
+                if (!legacy)
+                    glState.enable(GL_FRAMEBUFFER_SRGB);
+                writeShader.Use();
+                RenderQuad();
+                glState.disable(GL_FRAMEBUFFER_SRGB);
+
+                glState.bindFramebuffer(GL_FRAMEBUFFER, outputFBO);
+                glState.disable(GL_DEPTH_TEST);
+                readShader.Use();
+                for (int i = 0; i < GBufferLayout::TARGETS; ++i)
+                {
+                    glState.activeTexture(GL_TEXTURE0 + i);
+                    glState.bindTexture(GL_TEXTURE_2D, textures[i]);
+                }
+                RenderQuad();
+                // unbound before the next write, the targets are attached to it
+                for (int i = 0; i < GBufferLayout::TARGETS; ++i)
+                {
+                    glState.activeTexture(GL_TEXTURE0 + i);
+                    glState.bindTexture(GL_TEXTURE_2D, 0);
+                }
+            }
+            glEndQuery(GL_TIME_ELAPSED);
+            GLuint64 elapsed = 0;
+            glGetQueryObjectui64v(query, GL_QUERY_RESULT, &elapsed);
+
+            std::cout << "GBUFFER BENCHMARK - " << width << "x" << height << (legacy ? " legacy  : " : " compact : ")
+                      << gBufferTraffic(layout) / (double)(width * height) << " bytes/pixel, "
+                      << gBufferTraffic(layout) / (1024.0 * 1024.0) << " MB/frame, "
+                      << elapsed / 1000000.0 / ITERATIONS << " ms/frame" << std::endl;
+
+            for (int i = 0; i < GBufferLayout::TARGETS; ++i)
+                renderTargetPool.release(textures[i]);
+            renderTargetPool.release(output);
+        }
+    }
+    glDeleteQueries(1, &query);
+    glState.depthFunc(GL_LESS);
+    glState.enable(GL_DEPTH_TEST);
+    glState.bindFramebuffer(GL_FRAMEBUFFER, 0);
+    glViewport(0, 0, SCREEN_WIDTH, SCREEN_HEIGHT);
+}
+
+void benchmarkClusteredLights()
+{
+    const int ITERATIONS = 50;
+    const int counts[] = { 64, 256, 1024, 4096 };
+    const GLsizei width = 1920, height = 1080;
+
+    // the deferred model from the startup camera, as the render loop draws it
+    glm::mat4 view = camera.GetViewMatrix();
+    glm::mat4 projection = glm::perspective(camera.Zoom, (float)width / (float)height, 0.1f, FAR_PLANE);
+    glm::mat4 model;
+    model = glm::translate(model, glm::vec3(-0.5f, -1.0f, 0.0f));
+    model = glm::rotate(model, rotationAngle, glm::vec3(rotX, rotY, rotZ));
+    model = glm::scale(model, modelScale);
+    FrameBlock frame;
+    frame.view = view;
+    frame.projection = projection;
+    frame.camPos = camera.Position;
+    frame.time = 0.0f;
+    frame.inverseProjection = glm::inverse(projection);
+    frameBlock.update(frame);
+
+    // one geometry pass, the lighting pass is the one timed
+    GBufferLayout layout = gBufferLayout(width, height, false);
+    GLuint textures[GBufferLayout::TARGETS];
+    for (int i = 0; i < GBufferLayout::TARGETS; ++i)
+        textures[i] = renderTargetPool.acquire(layout.targets[i], "lights benchmark");
+    GLuint output = renderTargetPool.acquire(RenderTargetDesc(width, height, GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE), "lights benchmark output");
+    GLuint gBufferFBO = renderTargetPool.framebuffer(std::vector<GLuint>(textures + 1, textures + GBufferLayout::TARGETS), textures[0], false);
+    GLuint outputFBO = renderTargetPool.framebuffer(std::vector<GLuint>(1, output), 0, false);
+    GLuint volumeDepth = renderTargetPool.acquire(RenderTargetDesc(width, height, GL_DEPTH24_STENCIL8, GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8), "lights benchmark volume depth");
+    GLuint volumeFBO = renderTargetPool.framebuffer(std::vector<GLuint>(1, output), volumeDepth, true);
+    glViewport(0, 0, width, height);
+
+    glState.bindFramebuffer(GL_FRAMEBUFFER, gBufferFBO);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    Shader& geometryPass = modelGeometryPass.get(0);
+    geometryPass.Use();
+    geometryPass.setFloat("metallic", deferredMetallic);
+    geometryPass.setFloat("roughness", deferredRoughness);
+    glState.enable(GL_FRAMEBUFFER_SRGB);
+    renderQueue.clear();
+    ourModel.Submit(renderQueue, RENDER_PASS_OPAQUE, geometryPass, nullptr, model, view, FAR_PLANE);
+    renderQueue.sort();
+    renderQueue.execute();
+    glState.disable(GL_FRAMEBUFFER_SRGB);
+
+    GLuint query;
+    glGenQueries(1, &query);
+    glState.bindFramebuffer(GL_FRAMEBUFFER, outputFBO);
+    glState.disable(GL_DEPTH_TEST);
+    for (size_t c = 0; c < sizeof(counts) / sizeof(counts[0]); ++c)
+    {
+        clusteredLightsInit(counts[c], clusteredLightRadius, clusteredLightIntensity);
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        for (int iteration = 0; iteration < ITERATIONS; ++iteration)
+            clusteredLights.update(view, projection, 0.1f, FAR_PLANE, width, height);
+        double assignment = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / ITERATIONS;
+
+        double lighting[3];
+        for (int naive = 0; naive < 2; ++naive)
+        {
+            Shader& lightingPass = modelLightingPass.get(LIGHTING_CLUSTERED | (naive ? LIGHTING_CLUSTERED_NAIVE : 0));
+            lightingPass.Use();
+            // only the clustered lights
+            lightingPass.setVec3("light.Color", glm::vec3(0.0f));
+            clusteredLights.bind(lightingPass, 6);
+            const GLuint units[4] = { 0, 1, 2, 5 };
+            for (int i = 0; i < GBufferLayout::TARGETS; ++i)
+            {
+                glState.activeTexture(GL_TEXTURE0 + units[i]);
+                glState.bindTexture(GL_TEXTURE_2D, textures[i]);
+            }
+
+            // one untimed iteration so first use costs are out of the measure
+            for (int iteration = -1; iteration < ITERATIONS; ++iteration)
+            {
+                if (iteration == 0)
+                {
+                    glFinish();
+                    glBeginQuery(GL_TIME_ELAPSED, query);
+                }
+                RenderQuad();
+            }
+            glEndQuery(GL_TIME_ELAPSED);
+            GLuint64 elapsed = 0;
+            glGetQueryObjectui64v(query, GL_QUERY_RESULT, &elapsed);
+            lighting[naive] = elapsed / 1000000.0 / ITERATIONS;
+        }
+
+        // the light volumes over a copy of the G-buffer's depth, the G-buffer still bound
+        glState.bindFramebuffer(GL_READ_FRAMEBUFFER, gBufferFBO);
+        glState.bindFramebuffer(GL_DRAW_FRAMEBUFFER, volumeFBO);
+        glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+        glState.bindFramebuffer(GL_FRAMEBUFFER, volumeFBO);
+        glClear(GL_STENCIL_BUFFER_BIT);
+        for (int iteration = -1; iteration < ITERATIONS; ++iteration)
+        {
+            if (iteration == 0)
+            {
+                glFinish();
+                glBeginQuery(GL_TIME_ELAPSED, query);
+            }
+            renderLightVolumes(view);
+        }
+        glEndQuery(GL_TIME_ELAPSED);
+        GLuint64 elapsed = 0;
+        glGetQueryObjectui64v(query, GL_QUERY_RESULT, &elapsed);
+        lighting[2] = elapsed / 1000000.0 / ITERATIONS;
+        glState.bindFramebuffer(GL_FRAMEBUFFER, outputFBO);
+        glState.disable(GL_DEPTH_TEST);
+
+        std::cout << "LIGHTS BENCHMARK - " << width << "x" << height << " " << counts[c] << " lights : assignment "
+                  << assignment << " ms, " << clusteredLights.listEntries() << " list entries (longest "
+                  << clusteredLights.longestList() << "), clustered " << lighting[0] << " ms, naive " << lighting[1] << " ms, volumes " << lighting[2] << " ms" << std::endl;
+    }
+    glDeleteQueries(1, &query);
+
+    for (int i = 0; i < GBufferLayout::TARGETS; ++i)
+        renderTargetPool.release(textures[i]);
+    renderTargetPool.release(output);
+    renderTargetPool.release(volumeDepth);
+    clusteredLightsInit(clusteredLightCount, clusteredLightRadius, clusteredLightIntensity);
+    glState.enable(GL_DEPTH_TEST);
+    glState.bindFramebuffer(GL_FRAMEBUFFER, 0);
+    glViewport(0, 0, SCREEN_WIDTH, SCREEN_HEIGHT);
+}
+
+void updatePassBlock(const glm::mat4& view, const glm::mat4& projection, const glm::vec3& viewPos)
+{
+    PassBlock pass;
+    pass.view = view;
+    pass.projection = projection;
+    pass.viewPos = viewPos;
+    pass.padding = 0.0f;
+    passBlock.update(pass);
+}
+
+void renderPbrScene(const glm::mat4& model, const glm::mat4& view, const glm::mat4& projection, const glm::vec3& viewPos, bool clusteredLighting)
+{
+    updatePassBlock(view, projection, viewPos);
+    pbrShader.Use();
+
+    // bind pre-computed IBL data
+    glState.activeTexture(GL_TEXTURE0);
+    glState.bindTexture(GL_TEXTURE_CUBE_MAP, irradianceMap);
+    glState.activeTexture(GL_TEXTURE1);
+    glState.bindTexture(GL_TEXTURE_CUBE_MAP, prefilterMap);
+    glState.activeTexture(GL_TEXTURE2);
+    glState.bindTexture(GL_TEXTURE_2D, brdfLUT.getTextureID());
+
+    // PBR textures, bound by the queue with the object
+    pbrMaterial.clear();
+    pbrMaterial.addTexture(3, GL_TEXTURE_2D, objectAlbedo.getTextureID());
+    pbrMaterial.addTexture(4, GL_TEXTURE_2D, objectNormal.getTextureID());
+    pbrMaterial.addTexture(5, GL_TEXTURE_2D, objectMetallic.getTextureID());
+    pbrMaterial.addTexture(6, GL_TEXTURE_2D, objectRoughness.getTextureID());
+    pbrMaterial.addTexture(7, GL_TEXTURE_2D, objectAO.getTextureID());
+    reflectionProbes.bind(pbrShader, 8);
+    if (clusteredLighting)
+        clusteredLights.bind(pbrShader, 9);
+    else
+        ClusteredLights::unbind(pbrShader);
+
+    const GLsizei lightCount = sizeof(lightPositions) / sizeof(lightPositions[0]);
+    pbrShader.setVec3Array(pbrLightPositionsUniform, lightPositions, lightCount);
+    pbrShader.setVec3Array(pbrLightColorsUniform, lightColors, lightCount);
+
+    // the object and the light spheres, sorted by program then front to back
+    if (sphereVAO == 0)
+        sphereInit();
+    renderQueue.clear();
+    glm::mat4 lightModel;
+    renderQueue.submit(RENDER_PASS_OPAQUE, pbrShader, &pbrMaterial, sphereVAO, GL_TRIANGLE_STRIP, indexCount, true, model,
+                       RenderQueue::viewDepth(view, model, glm::vec3(0.0f), FAR_PLANE));
+    //ourModel.Submit(renderQueue, RENDER_PASS_OPAQUE, pbrShader, &pbrMaterial, model, view, FAR_PLANE);
+    
+    for (GLsizei i = 0; i < lightCount; ++i)
+    {
+        lightModel = glm::mat4();
+        lightModel = glm::translate(lightModel, lightPositions[i]);
+        lightModel = glm::scale(lightModel, glm::vec3(0.5f)); // Make it a smaller cube
+        renderQueue.submit(RENDER_PASS_OPAQUE, lightSource, nullptr, sphereVAO, GL_TRIANGLE_STRIP, indexCount, true, lightModel,
+                           RenderQueue::viewDepth(view, lightModel, glm::vec3(0.0f), FAR_PLANE));
+    }
+    renderQueue.sort();
+    renderQueue.execute();
+
+
+    // render skybox (render as last to prevent overdraw)
+    profiler.begin("skybox");
+    glState.depthFunc(GL_LEQUAL);
+    backgroundShader.Use();
+    glState.activeTexture(GL_TEXTURE0);
+    glState.bindTexture(GL_TEXTURE_CUBE_MAP, envCubemap);
+    RenderCube();
+    profiler.end();
+}
+
+void renderLightVolumes(const glm::mat4& view)
+{
+    if (sphereVAO == 0)
+        sphereInit();
+    // the sphere is tessellated, its faces are inside the unit sphere: scaled up a little to contain the light
+    const float SPHERE_SCALE = 1.01f;
+    glState.bindVertexArray(sphereVAO);
+    glState.enable(GL_STENCIL_TEST);
+    glState.disable(GL_CULL_FACE);
+    glState.depthMask(GL_FALSE);
+    glState.blendFunc(GL_ONE, GL_ONE);
+
+    for (size_t i = 0; i < clusteredLights.lights.size(); ++i)
+    {
+        const PointLight& light = clusteredLights.lights[i];
+        glm::vec3 center = glm::vec3(view * glm::vec4(light.position, 1.0f));
+        // entirely behind the near plane
+        if (center.z - light.radius > -0.1f)
+            continue;
+        glm::mat4 model;
+        model = glm::translate(model, light.position);
+        model = glm::scale(model, glm::vec3(light.radius * SPHERE_SCALE));
+
+        // 1. stencil: the depth fails of the back faces minus those of the front faces leave a non-zero count on the
+        // pixels whose surface lies inside the sphere; the wrapping operations make it the same either winding
+        lightVolumeStencilShader.Use();
+        lightVolumeStencilShader.setMat4(lightVolumeStencilModelUniform, model);
+        glState.colorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+        glState.enable(GL_DEPTH_TEST);
+        glState.disable(GL_BLEND);
+        glState.stencilFunc(GL_ALWAYS, 0, 0);
+        glState.stencilOpSeparate(GL_BACK, GL_KEEP, GL_INCR_WRAP, GL_KEEP);
+        glState.stencilOpSeparate(GL_FRONT, GL_KEEP, GL_DECR_WRAP, GL_KEEP);
+        glDrawElements(GL_TRIANGLE_STRIP, indexCount, GL_UNSIGNED_INT, 0);
+
+        // 2. shading: the first fragment over a marked pixel adds the light and zeroes the count, so each pixel is
+        // lit once and the stencil is clear again for the next light
+        lightVolumeShader.Use();
+        lightVolumeShader.setMat4(lightVolumeModelUniform, model);
+        lightVolumeShader.setVec3(lightVolumePositionUniform, center);
+        lightVolumeShader.setFloat(lightVolumeRadiusUniform, light.radius);
+        lightVolumeShader.setVec3(lightVolumeColorUniform, light.color);
+        glState.colorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+        glState.disable(GL_DEPTH_TEST);
+        glState.enable(GL_BLEND);
+        glState.stencilFunc(GL_NOTEQUAL, 0, 0xFF);
+        glState.stencilOp(GL_KEEP, GL_KEEP, GL_ZERO);
+        glDrawElements(GL_TRIANGLE_STRIP, indexCount, GL_UNSIGNED_INT, 0);
+    }
+
+    // the clears of the following passes need the color writes back
+    glState.colorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+    glState.disable(GL_STENCIL_TEST);
+    glState.disable(GL_BLEND);
+    glState.enable(GL_DEPTH_TEST);
+    glState.depthMask(GL_TRUE);
+}
+
+// Runs this frame's share of the reflection probe updates: the capture or the prefilter of one cubemap face
+void updateReflectionProbes(const glm::mat4& model)
+{
+    GLuint probe, face;
+    bool prefilter;
+    if (!reflectionProbes.nextStep(probe, face, prefilter))
+        return;
+
+    const GLuint size = ReflectionProbes::CAPTURE_SIZE;
+    glState.bindFramebuffer(GL_FRAMEBUFFER, reflectionProbes.captureFBO);
+    if (!prefilter)
+    {
+        // capture the scene around the probe, with the same face views as the environment bake in pbrInit()
+        glm::vec3 position = reflectionProbes.probes[probe].position;
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, reflectionProbes.captureCubemap, 0);
+        glViewport(0, 0, size, size);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        renderPbrScene(model, ReflectionProbes::faceView(face, position), ReflectionProbes::faceProjection(), position, false);
+    }
+    else
+    {
+        // all faces are captured, prefilter one face into the probe's layer of the array
+        glState.activeTexture(GL_TEXTURE0);
+        glState.bindTexture(GL_TEXTURE_CUBE_MAP, reflectionProbes.captureCubemap);
+        if (face == 0)
+            glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
+
+        prefilterShader.Use();
+        prefilterShader.setInt("environmentMap", 0);
+        prefilterShader.setFloat("resolution", (float)size);
+        updatePassBlock(ReflectionProbes::faceView(face, glm::vec3(0.0f, 0.0f, 0.0f)), glm::perspective(glm::radians(90.0f), 1.0f, 0.1f, 10.0f), glm::vec3(0.0f));
+        for (GLuint mip = 0; mip < ReflectionProbes::MIP_LEVELS; ++mip)
+        {
+            glViewport(0, 0, size >> mip, size >> mip);
+            prefilterShader.setFloat("roughness", (float)mip / (float)(ReflectionProbes::MIP_LEVELS - 1));
+            glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, reflectionProbes.probeArray, mip, probe * 6 + face);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            RenderCube();
+        }
+    }
+    glState.bindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    fixScreenSize(window);
+}
+
+// Orders SortItems by key, the comparison sort the radix sort is measured against
+bool sortItemLess(const RenderQueue::SortItem& a, const RenderQueue::SortItem& b)
+{
+    return a.key < b.key;
+}
+
+// Sorts 10000 draws mixing programs, materials, vertex arrays and depths, timing the radix sort against
+// std::sort and counting the state changes of the submission order against the sorted order
+void benchmarkRenderQueue()
+{
+    const int DRAWS = 10000, PROGRAMS = 16, MATERIALS = 64, VERTEX_ARRAYS = 32, RUNS = 100;
+
+    // only the names are used, nothing is compiled or drawn
+    std::vector<Shader> programs(PROGRAMS);
+    for (int i = 0; i < PROGRAMS; ++i)
+        programs[i].Program = i + 1;
+    std::vector<RenderMaterial> materials(MATERIALS);
+
+    std::default_random_engine generator(7);
+    std::uniform_int_distribution<int> pickProgram(0, PROGRAMS - 1), pickMaterial(0, MATERIALS - 1), pickVertexArray(1, VERTEX_ARRAYS);
+    std::uniform_real_distribution<float> pickDepth(0.0f, 1.0f);
+    RenderQueue queue;
+    std::vector<RenderQueue::SortItem> input;
+    for (int i = 0; i < DRAWS; ++i)
+    {
+        // one draw in ten is translucent
+        RenderPass pass = i % 10 == 0 ? RENDER_PASS_TRANSLUCENT : RENDER_PASS_OPAQUE;
+        const Shader& shader = programs[pickProgram(generator)];
+        const RenderMaterial& material = materials[pickMaterial(generator)];
+        GLuint vertexArray = pickVertexArray(generator);
+        float depth = pickDepth(generator);
+        queue.submit(pass, shader, &material, vertexArray, GL_TRIANGLES, 36, false, glm::mat4(), depth);
+
+        RenderQueue::SortItem item;
+        item.key = RenderQueue::makeKey(pass, shader.Program, material.id, vertexArray, depth);
+        item.packet = i;
+        input.push_back(item);
+    }
+    RenderQueue::Statistics unsorted = queue.countStateChanges();
+    queue.sort();
+    RenderQueue::Statistics sorted = queue.countStateChanges();
+
+    std::vector<RenderQueue::SortItem> items, scratch;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int run = 0; run < RUNS; ++run)
+    {
+        items = input;
+        RenderQueue::radixSort(items, scratch);
+    }
+    double radix = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / RUNS;
+
+    start = std::chrono::steady_clock::now();
+    for (int run = 0; run < RUNS; ++run)
+    {
+        items = input;
+        std::stable_sort(items.begin(), items.end(), sortItemLess);
+    }
+    double comparison = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / RUNS;
+
+    std::cout << "QUEUE BENCHMARK - " << DRAWS << " draws, radix sort : " << radix << " ms, std::stable_sort : " << comparison << " ms" << std::endl;
+    std::cout << "QUEUE BENCHMARK - submission order : " << unsorted.programs << " programs, " << unsorted.materials << " materials, "
+              << unsorted.vertexArrays << " vertex arrays" << std::endl;
+    std::cout << "QUEUE BENCHMARK - sorted : " << sorted.programs << " programs, " << sorted.materials << " materials, "
+              << sorted.vertexArrays << " vertex arrays" << std::endl;
+}
+
+// Loads the reflection and environment maps of a registered environment and bakes its IBL cubemaps
+void loadEnvironment(int index)
+{
+    if (index < 0 || index >= (int)environmentRegistry.environments.size())
+        return;
+
+    const Environment& environment = environmentRegistry.environments[index];
+    currentEnvironment = index;
+
+    // sIBL maps are stored top row first, flip them for the bottom up OpenGL texture origin
+    hdrTexture = envHDR.loadHDR(environment.refPath.c_str(), environment.name + " reflection", true);
+    if (environment.evPath != environment.refPath)
+    {
+        hdrIrradianceTexture = envIrradianceHDR.loadHDR(environment.evPath.c_str(), environment.name + " environment", true);
+    }
+    else
+    {
+        envIrradianceHDR.texID.release();
+        hdrIrradianceTexture = 0;
+    }
+
+    pbrInit(environment);
+    fixScreenSize(window);
+}
+
+void pbrInit(const Environment& environment)
 {
     // pbr: setup framebuffer
     // ----------------------
-    glGenFramebuffers(1, &captureFBO);
-    glGenRenderbuffers(1, &captureRBO);
+    // re-creating a handle deletes the objects baked for the previous environment
+    captureFBO.create("captureFBO");
+    captureRBO.create("captureRBO");
 
-    glBindFramebuffer(GL_FRAMEBUFFER, captureFBO);
+    glState.bindFramebuffer(GL_FRAMEBUFFER, captureFBO);
     glBindRenderbuffer(GL_RENDERBUFFER, captureRBO);
     glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, 512, 512);
+    captureRBO.setMemory(GpuMemory::textureBytes(GL_DEPTH_COMPONENT24, 512, 512));
     glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, captureRBO);
 
     // pbr: setup cubemap to render to and attach to framebuffer
     // ---------------------------------------------------------
-    glGenTextures(1, &envCubemap);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, envCubemap);
+    envCubemap.create("envCubemap");
+    glState.bindTexture(GL_TEXTURE_CUBE_MAP, envCubemap);
     for (GLuint i = 0; i < 6; ++i)
     {
         glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB16F, 512, 512, 0, GL_RGB, GL_FLOAT, nullptr);
     }
+    envCubemap.setMemory(GpuMemory::textureBytes(GL_RGB16F, 512, 512, 6, true));
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
@@ -977,82 +2256,128 @@ void pbrInit()
     // pbr: set up projection and view matrices for capturing data onto the 6 cubemap face directions
     // ----------------------------------------------------------------------------------------------
     glm::mat4 captureProjection = glm::perspective(glm::radians(90.0f), 1.0f, 0.1f, 10.0f);
-    glm::mat4 captureViews[] =
+    glm::mat4 captureViews[6];
+    for (GLuint i = 0; i < 6; ++i)
     {
-        glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(1.0f,  0.0f,  0.0f), glm::vec3(0.0f, -1.0f,  0.0f)),
-        glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(-1.0f,  0.0f,  0.0f), glm::vec3(0.0f, -1.0f,  0.0f)),
-        glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f,  1.0f,  0.0f), glm::vec3(0.0f,  0.0f,  1.0f)),
-        glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, -1.0f,  0.0f), glm::vec3(0.0f,  0.0f, -1.0f)),
-        glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f,  0.0f,  1.0f), glm::vec3(0.0f, -1.0f,  0.0f)),
-        glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f,  0.0f, -1.0f), glm::vec3(0.0f, -1.0f,  0.0f))
-    };
+        captureViews[i] = ReflectionProbes::faceView(i, glm::vec3(0.0f, 0.0f, 0.0f));
+    }
 
     // pbr: convert HDR equirectangular environment map to cubemap equivalent
     // ----------------------------------------------------------------------
     rectToCubemap.Use();
     rectToCubemap.setInt("equirectangularMap", 0);
-    rectToCubemap.setMat4("projection", captureProjection);
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, hdrTexture);
+    rectToCubemap.setFloat("multiplier", environment.refMulti);
+    rectToCubemap.setFloat("gamma", environment.refGamma);
+    glState.activeTexture(GL_TEXTURE0);
+    glState.bindTexture(GL_TEXTURE_2D, hdrTexture);
 
     glViewport(0, 0, 512, 512); // don't forget to configure the viewport to the capture dimensions.
-    glBindFramebuffer(GL_FRAMEBUFFER, captureFBO);
+    glState.bindFramebuffer(GL_FRAMEBUFFER, captureFBO);
     for (GLuint i = 0; i < 6; ++i)
     {
-        rectToCubemap.setMat4("view", captureViews[i]);
+        updatePassBlock(captureViews[i], captureProjection, glm::vec3(0.0f));
         glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, envCubemap, 0);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
         RenderCube();
     }
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glState.bindFramebuffer(GL_FRAMEBUFFER, 0);
 
     // then let OpenGL generate mipmaps from first mip face (combatting visible dots artifact)
-    glBindTexture(GL_TEXTURE_CUBE_MAP, envCubemap);
+    glState.bindTexture(GL_TEXTURE_CUBE_MAP, envCubemap);
     glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
 
+    // pbr: convert the small environment map for the diffuse bake, the reflection map is only used for specular
+    // ---------------------------------------------------------------------------------------------------------
+    GLuint irradianceSource = envCubemap;
+    if (hdrIrradianceTexture != 0)
+    {
+        // a 360x180 environment map holds less detail than a 64x64 face
+        irradianceSourceCubemap.create("irradianceSourceCubemap");
+        glState.bindTexture(GL_TEXTURE_CUBE_MAP, irradianceSourceCubemap);
+        for (GLuint i = 0; i < 6; ++i)
+        {
+            glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB16F, 64, 64, 0, GL_RGB, GL_FLOAT, nullptr);
+        }
+        irradianceSourceCubemap.setMemory(GpuMemory::textureBytes(GL_RGB16F, 64, 64, 6));
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+        glState.bindFramebuffer(GL_FRAMEBUFFER, captureFBO);
+        glBindRenderbuffer(GL_RENDERBUFFER, captureRBO);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, 64, 64);
+        captureRBO.setMemory(GpuMemory::textureBytes(GL_DEPTH_COMPONENT24, 64, 64));
+
+        rectToCubemap.Use();
+        rectToCubemap.setFloat("multiplier", environment.evMulti);
+        rectToCubemap.setFloat("gamma", environment.evGamma);
+        glState.activeTexture(GL_TEXTURE0);
+        glState.bindTexture(GL_TEXTURE_2D, hdrIrradianceTexture);
+
+        glViewport(0, 0, 64, 64);
+        for (GLuint i = 0; i < 6; ++i)
+        {
+            updatePassBlock(captureViews[i], captureProjection, glm::vec3(0.0f));
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, irradianceSourceCubemap, 0);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+            RenderCube();
+        }
+        glState.bindFramebuffer(GL_FRAMEBUFFER, 0);
+
+        irradianceSource = irradianceSourceCubemap;
+    }
+    else
+    {
+        irradianceSourceCubemap.release();
+    }
+
     // pbr: create an irradiance cubemap, and re-scale capture FBO to irradiance scale.
     // --------------------------------------------------------------------------------
-    glGenTextures(1, &irradianceMap);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, irradianceMap);
+    irradianceMap.create("irradianceMap");
+    glState.bindTexture(GL_TEXTURE_CUBE_MAP, irradianceMap);
     for (GLuint i = 0; i < 6; ++i)
     {
         glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB16F, 32, 32, 0, GL_RGB, GL_FLOAT, nullptr);
     }
+    irradianceMap.setMemory(GpuMemory::textureBytes(GL_RGB16F, 32, 32, 6));
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
-    glBindFramebuffer(GL_FRAMEBUFFER, captureFBO);
+    glState.bindFramebuffer(GL_FRAMEBUFFER, captureFBO);
     glBindRenderbuffer(GL_RENDERBUFFER, captureRBO);
     glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, 32, 32);
+    captureRBO.setMemory(GpuMemory::textureBytes(GL_DEPTH_COMPONENT24, 32, 32));
 
     // pbr: solve diffuse integral by convolution to create an irradiance (cube)map.
     // -----------------------------------------------------------------------------
     irradianceShader.Use();
     irradianceShader.setInt("environmentMap", 0);
-    irradianceShader.setMat4("projection", captureProjection);
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, envCubemap);
+    glState.activeTexture(GL_TEXTURE0);
+    glState.bindTexture(GL_TEXTURE_CUBE_MAP, irradianceSource);
 
     glViewport(0, 0, 32, 32); // don't forget to configure the viewport to the capture dimensions.
-    glBindFramebuffer(GL_FRAMEBUFFER, captureFBO);
+    glState.bindFramebuffer(GL_FRAMEBUFFER, captureFBO);
     for (GLuint i = 0; i < 6; ++i)
     {
-        irradianceShader.setMat4("view", captureViews[i]);
+        updatePassBlock(captureViews[i], captureProjection, glm::vec3(0.0f));
         glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, irradianceMap, 0);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
         RenderCube();
     }
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glState.bindFramebuffer(GL_FRAMEBUFFER, 0);
 
     // pbr: create a pre-filter cubemap, and re-scale capture FBO to pre-filter scale.
     // --------------------------------------------------------------------------------
-    glGenTextures(1, &prefilterMap);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, prefilterMap);
+    prefilterMap.create("prefilterMap");
+    glState.bindTexture(GL_TEXTURE_CUBE_MAP, prefilterMap);
     for (GLuint i = 0; i < 6; ++i)
     {
         glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB16F, 128, 128, 0, GL_RGB, GL_FLOAT, nullptr);
@@ -1064,16 +2389,17 @@ void pbrInit()
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
     // generate mipmaps for the cubemap so OpenGL automatically allocates the required memory.
     glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
+    prefilterMap.setMemory(GpuMemory::textureBytes(GL_RGB16F, 128, 128, 6, true));
 
     // pbr: run a quasi monte-carlo simulation on the environment lighting to create a prefilter (cube)map.
     // ----------------------------------------------------------------------------------------------------
     prefilterShader.Use();
     prefilterShader.setInt("environmentMap", 0);
-    prefilterShader.setMat4("projection", captureProjection);
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, envCubemap);
+    prefilterShader.setFloat("resolution", 512.0f);
+    glState.activeTexture(GL_TEXTURE0);
+    glState.bindTexture(GL_TEXTURE_CUBE_MAP, envCubemap);
 
-    glBindFramebuffer(GL_FRAMEBUFFER, captureFBO);
+    glState.bindFramebuffer(GL_FRAMEBUFFER, captureFBO);
     GLuint maxMipLevels = 5;
     for (GLuint mip = 0; mip < maxMipLevels; ++mip)
     {
@@ -1082,46 +2408,25 @@ void pbrInit()
         GLuint mipHeight = 128 * std::pow(0.5, mip);
         glBindRenderbuffer(GL_RENDERBUFFER, captureRBO);
         glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, mipWidth, mipHeight);
+        captureRBO.setMemory(GpuMemory::textureBytes(GL_DEPTH_COMPONENT24, mipWidth, mipHeight));
         glViewport(0, 0, mipWidth, mipHeight);
 
         float roughness = (float)mip / (float)(maxMipLevels - 1);
         prefilterShader.setFloat("roughness", roughness);
         for (GLuint i = 0; i < 6; ++i)
         {
-            prefilterShader.setMat4("view", captureViews[i]);
+            updatePassBlock(captureViews[i], captureProjection, glm::vec3(0.0f));
             glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, prefilterMap, mip);
 
             glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
             RenderCube();
         }
     }
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
-
-    // pbr: generate a 2D LUT from the BRDF equations used.
-    // ----------------------------------------------------
-    glGenTextures(1, &brdfLUTTexture);
-
-    // pre-allocate enough memory for the LUT texture.
-    glBindTexture(GL_TEXTURE_2D, brdfLUTTexture);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RG16F, 512, 512, 0, GL_RG, GL_FLOAT, 0);
-    // be sure to set wrapping mode to GL_CLAMP_TO_EDGE
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-    // then re-configure capture framebuffer object and render screen-space quad with BRDF shader.
-    glBindFramebuffer(GL_FRAMEBUFFER, captureFBO);
-    glBindRenderbuffer(GL_RENDERBUFFER, captureRBO);
-    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, 512, 512);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, brdfLUTTexture, 0);
+    glState.bindFramebuffer(GL_FRAMEBUFFER, 0);
 
-    glViewport(0, 0, 512, 512);
-    brdfShader.Use();
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-    RenderQuad();
-
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    // the capture targets are only needed while baking
+    captureRBO.release();
+    captureFBO.release();
 }
 
 void skyboxInit()
@@ -1173,12 +2478,12 @@ void skyboxInit()
     // Setup skybox VAO
     glGenVertexArrays(1, &skyboxVAO);
     glGenBuffers(1, &skyboxVBO);
-    glBindVertexArray(skyboxVAO);
+    glState.bindVertexArray(skyboxVAO);
     glBindBuffer(GL_ARRAY_BUFFER, skyboxVBO);
     glBufferData(GL_ARRAY_BUFFER, sizeof(skyboxVertices), &skyboxVertices, GL_STATIC_DRAW);
     glEnableVertexAttribArray(0);
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(GLfloat), (GLvoid*)0);
-    glBindVertexArray(0);
+    glState.bindVertexArray(0);
 }
 
 void fixScreenSize(GLFWwindow* window)
@@ -1198,99 +2503,100 @@ GLfloat lerp(GLfloat a, GLfloat b, GLfloat f)
 
 // renders (and builds at first invocation) a sphere
 // -------------------------------------------------
-GLuint sphereVAO = 0;
-GLuint indexCount;
 void RenderSphere()
 {
     if (sphereVAO == 0)
-    {
-        glGenVertexArrays(1, &sphereVAO);
+        sphereInit();
+
+    glState.bindVertexArray(sphereVAO);
+    glDrawElements(GL_TRIANGLE_STRIP, indexCount, GL_UNSIGNED_INT, 0);
+}
+
+void sphereInit()
+{
+    glGenVertexArrays(1, &sphereVAO);
 
-        GLuint vbo, ebo;
-        glGenBuffers(1, &vbo);
-        glGenBuffers(1, &ebo);
+    GLuint vbo, ebo;
+    glGenBuffers(1, &vbo);
+    glGenBuffers(1, &ebo);
 
-        std::vector<glm::vec3> positions;
-        std::vector<glm::vec2> uv;
-        std::vector<glm::vec3> normals;
-        std::vector<GLuint> indices;
+    std::vector<glm::vec3> positions;
+    std::vector<glm::vec2> uv;
+    std::vector<glm::vec3> normals;
+    std::vector<GLuint> indices;
 
-        const GLuint X_SEGMENTS = 64;
-        const GLuint Y_SEGMENTS = 64;
-        const float PI = 3.14159265359;
-        for (GLuint y = 0; y <= Y_SEGMENTS; ++y)
+    const GLuint X_SEGMENTS = 64;
+    const GLuint Y_SEGMENTS = 64;
+    const float PI = 3.14159265359;
+    for (GLuint y = 0; y <= Y_SEGMENTS; ++y)
+    {
+        for (GLuint x = 0; x <= X_SEGMENTS; ++x)
         {
-            for (GLuint x = 0; x <= X_SEGMENTS; ++x)
-            {
-                float xSegment = (float)x / (float)X_SEGMENTS;
-                float ySegment = (float)y / (float)Y_SEGMENTS;
-                float xPos = std::cos(xSegment * 2.0f * PI) * std::sin(ySegment * PI);
-                float yPos = std::cos(ySegment * PI);
-                float zPos = std::sin(xSegment * 2.0f * PI) * std::sin(ySegment * PI);
-
-                positions.push_back(glm::vec3(xPos, yPos, zPos));
-                uv.push_back(glm::vec2(xSegment, ySegment));
-                normals.push_back(glm::vec3(xPos, yPos, zPos));
-            }
+            float xSegment = (float)x / (float)X_SEGMENTS;
+            float ySegment = (float)y / (float)Y_SEGMENTS;
+            float xPos = std::cos(xSegment * 2.0f * PI) * std::sin(ySegment * PI);
+            float yPos = std::cos(ySegment * PI);
+            float zPos = std::sin(xSegment * 2.0f * PI) * std::sin(ySegment * PI);
+
+            positions.push_back(glm::vec3(xPos, yPos, zPos));
+            uv.push_back(glm::vec2(xSegment, ySegment));
+            normals.push_back(glm::vec3(xPos, yPos, zPos));
         }
+    }
 
-        bool oddRow = false;
-        for (int y = 0; y < Y_SEGMENTS; ++y)
+    bool oddRow = false;
+    for (int y = 0; y < Y_SEGMENTS; ++y)
+    {
+        if (!oddRow) // even rows: y == 0, y == 2; and so on
         {
-            if (!oddRow) // even rows: y == 0, y == 2; and so on
-            {
-                for (int x = 0; x <= X_SEGMENTS; ++x)
-                {
-                    indices.push_back(y       * (X_SEGMENTS + 1) + x);
-                    indices.push_back((y + 1) * (X_SEGMENTS + 1) + x);
-                }
-            }
-            else
+            for (int x = 0; x <= X_SEGMENTS; ++x)
             {
-                for (int x = X_SEGMENTS; x >= 0; --x)
-                {
-                    indices.push_back((y + 1) * (X_SEGMENTS + 1) + x);
-                    indices.push_back(y       * (X_SEGMENTS + 1) + x);
-                }
+                indices.push_back(y       * (X_SEGMENTS + 1) + x);
+                indices.push_back((y + 1) * (X_SEGMENTS + 1) + x);
             }
-            oddRow = !oddRow;
         }
-        indexCount = indices.size();
-
-        std::vector<float> data;
-        for (int i = 0; i < positions.size(); ++i)
+        else
         {
-            data.push_back(positions[i].x);
-            data.push_back(positions[i].y);
-            data.push_back(positions[i].z);
-            if (uv.size() > 0)
-            {
-                data.push_back(uv[i].x);
-                data.push_back(uv[i].y);
-            }
-            if (normals.size() > 0)
+            for (int x = X_SEGMENTS; x >= 0; --x)
             {
-                data.push_back(normals[i].x);
-                data.push_back(normals[i].y);
-                data.push_back(normals[i].z);
+                indices.push_back((y + 1) * (X_SEGMENTS + 1) + x);
+                indices.push_back(y       * (X_SEGMENTS + 1) + x);
             }
         }
-        glBindVertexArray(sphereVAO);
-        glBindBuffer(GL_ARRAY_BUFFER, vbo);
-        glBufferData(GL_ARRAY_BUFFER, data.size() * sizeof(float), &data[0], GL_STATIC_DRAW);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLuint), &indices[0], GL_STATIC_DRAW);
-        float stride = (3 + 2 + 3) * sizeof(float);
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void*)0);
-        glEnableVertexAttribArray(1);
-        glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, stride, (void*)(3 * sizeof(float)));
-        glEnableVertexAttribArray(2);
-        glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, stride, (void*)(5 * sizeof(float)));
+        oddRow = !oddRow;
     }
+    indexCount = indices.size();
 
-    glBindVertexArray(sphereVAO);
-    glDrawElements(GL_TRIANGLE_STRIP, indexCount, GL_UNSIGNED_INT, 0);
+    std::vector<float> data;
+    for (int i = 0; i < positions.size(); ++i)
+    {
+        data.push_back(positions[i].x);
+        data.push_back(positions[i].y);
+        data.push_back(positions[i].z);
+        if (uv.size() > 0)
+        {
+            data.push_back(uv[i].x);
+            data.push_back(uv[i].y);
+        }
+        if (normals.size() > 0)
+        {
+            data.push_back(normals[i].x);
+            data.push_back(normals[i].y);
+            data.push_back(normals[i].z);
+        }
+    }
+    glState.bindVertexArray(sphereVAO);
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    glBufferData(GL_ARRAY_BUFFER, data.size() * sizeof(float), &data[0], GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLuint), &indices[0], GL_STATIC_DRAW);
+    float stride = (3 + 2 + 3) * sizeof(float);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void*)0);
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, stride, (void*)(3 * sizeof(float)));
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, stride, (void*)(5 * sizeof(float)));
 }
 
 // RenderQuad() Renders a 1x1 quad in NDC, best used for framebuffer color targets
@@ -1311,7 +2617,7 @@ void RenderQuad()
         // Setup plane VAO
         glGenVertexArrays(1, &quadVAO);
         glGenBuffers(1, &quadVBO);
-        glBindVertexArray(quadVAO);
+        glState.bindVertexArray(quadVAO);
         glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
         glBufferData(GL_ARRAY_BUFFER, sizeof(quadVertices), &quadVertices, GL_STATIC_DRAW);
         glEnableVertexAttribArray(0);
@@ -1319,9 +2625,8 @@ void RenderQuad()
         glEnableVertexAttribArray(1);
         glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(GLfloat), (GLvoid*)(3 * sizeof(GLfloat)));
     }
-    glBindVertexArray(quadVAO);
+    glState.bindVertexArray(quadVAO);
     glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
-    glBindVertexArray(0);
 }
 
 // renderCube() renders a 1x1 3D cube in NDC.
@@ -1383,7 +2688,7 @@ void RenderCube()
         glBindBuffer(GL_ARRAY_BUFFER, cubeVBO);
         glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
         // link vertex attributes
-        glBindVertexArray(cubeVAO);
+        glState.bindVertexArray(cubeVAO);
         glEnableVertexAttribArray(0);
         glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
         glEnableVertexAttribArray(1);
@@ -1391,12 +2696,11 @@ void RenderCube()
         glEnableVertexAttribArray(2);
         glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
         glBindBuffer(GL_ARRAY_BUFFER, 0);
-        glBindVertexArray(0);
+        glState.bindVertexArray(0);
     }
     // render Cube
-    glBindVertexArray(cubeVAO);
+    glState.bindVertexArray(cubeVAO);
     glDrawArrays(GL_TRIANGLES, 0, 36);
-    glBindVertexArray(0);
 }
 
 
@@ -1423,6 +2727,12 @@ void framebuffer_size_callback(GLFWwindow* window, int width, int height)
     // make sure the viewport matches the new window dimensions; note that width and 
     // height will be significantly larger than specified on retina displays.
     glViewport(0, 0, width, height);
+    // a minimized window has no framebuffer, the targets keep their last size
+    if (width == 0 || height == 0)
+        return;
+    // the next frame graph asks the pool for targets of the new size, the old ones are deleted once idle
+    SCREEN_WIDTH = width;
+    SCREEN_HEIGHT = height;
 }
 
 
@@ -9,7 +9,7 @@ in VS_OUT {
 
 uniform sampler2D floorTexture;
 uniform vec3 lightPos;
-uniform vec3 viewPos;
+#include "include/frame_block.glsl"
 uniform bool blinn;
 
 void main()
@@ -23,7 +23,7 @@ void main()
     float diff = max(dot(lightDir, normal), 0.0);
     vec3 diffuse = diff * color;
     // Specular
-    vec3 viewDir = normalize(viewPos - fs_in.FragPos);
+    vec3 viewDir = normalize(camPos - fs_in.FragPos);
     vec3 reflectDir = reflect(-lightDir, normal);
     float spec = 0.0;
     if(blinn)
@@ -10,8 +10,7 @@ out VS_OUT {
     vec2 TexCoords;
 } vs_out;
 
-uniform mat4 projection;
-uniform mat4 view;
+#include "include/frame_block.glsl"
 
 void main()
 {
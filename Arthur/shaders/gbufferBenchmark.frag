@@ -0,0 +1,17 @@
+#version 330 core
+// Geometry pass stand-in of benchmarkGBuffer(): fills every color target of the layout being measured
+layout (location = 0) out vec4 target0;
+layout (location = 1) out vec4 target1;
+layout (location = 2) out vec4 target2;
+layout (location = 3) out vec4 target3;
+
+in vec2 TexCoords;
+
+void main()
+{
+    vec4 value = vec4(TexCoords, 0.5, 1.0);
+    target0 = value;
+    target1 = value;
+    target2 = value;
+    target3 = value;
+}
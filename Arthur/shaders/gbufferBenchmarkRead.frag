@@ -0,0 +1,16 @@
+#version 330 core
+// Lighting pass stand-in of benchmarkGBuffer(): reads one texel of every target of the layout being measured
+out vec4 FragColor;
+
+in vec2 TexCoords;
+
+uniform sampler2D target0;
+uniform sampler2D target1;
+uniform sampler2D target2;
+uniform sampler2D target3;
+
+void main()
+{
+    ivec2 texel = ivec2(gl_FragCoord.xy);
+    FragColor = texelFetch(target0, texel, 0) + texelFetch(target1, texel, 0) + texelFetch(target2, texel, 0) + texelFetch(target3, texel, 0);
+}
@@ -0,0 +1,127 @@
+#version 330 core
+// Ground truth ambient occlusion (Jimenez et al. 2016): for a few slices around the view vector, the horizon
+// angles on both sides are searched along the slice's screen direction in the depth buffer, and the
+// cosine weighted visible arc between them is integrated analytically. A few slices of a few steps give
+// the quality the hemisphere kernel needs 64 samples for, and the same integral yields the bent normal.
+// occlusion packed with the guides of the bilateral blur and upsample: r occlusion, g view space depth, ba octahedral normal
+layout (location = 0) out vec4 FragColor;
+// view space bent normal: the average unoccluded direction
+layout (location = 1) out vec3 BentNormal;
+
+in vec2 TexCoords;
+
+// depth buffer, or its reduced resolution copy
+uniform sampler2D gDepth;
+uniform sampler2D gNormal;
+uniform sampler2D texNoise;
+
+#include "include/frame_block.glsl"
+#include "include/view_position.glsl"
+
+uniform float radius;
+uniform float bias;
+uniform int power;
+// slice directions, and horizon search steps on each side of a slice
+uniform int sliceCount;
+uniform int stepCount;
+
+// tiles the 4x4 noise texture once every 4 texels of the SSAO target, whatever its resolution
+uniform vec2 noiseScale;
+// per frame offsets of the slice rotation and of the step jitter for the temporal accumulation, 0 without it
+uniform vec2 temporalOffset;
+
+#include "include/gbuffer.glsl"
+
+const float PI = 3.14159265359;
+const float HALF_PI = 1.57079632679;
+
+void main()
+{
+    float depth = texture(gDepth, TexCoords).r;
+    vec3 fragPos = viewPositionFromDepth(depth, TexCoords);
+    vec3 normal = decodeGBufferNormal(texture(gNormal, TexCoords).rg);
+    // nothing was drawn here
+    if (depth >= 1.0)
+    {
+        FragColor = vec4(1.0, fragPos.z, encodeOctahedral(normal));
+        BentNormal = normal;
+        return;
+    }
+    vec3 viewVec = normalize(-fragPos);
+    // lifting the origin along the normal keeps tessellated surfaces from occluding themselves
+    vec3 origin = fragPos + normal * bias;
+
+    // the slices are rotated per pixel by the noise texture and the steps jittered by interleaved gradient noise,
+    // the blur turns both into a smooth result
+    vec2 noise = texture(texNoise, TexCoords * noiseScale).xy;
+    float rotation = atan(noise.y, noise.x) / PI + temporalOffset.x;
+    float jitter = fract(52.9829189 * fract(dot(gl_FragCoord.xy, vec2(0.06711056, 0.00583715))) + temporalOffset.y);
+
+    // radius projected to texture coordinates at the pixel's depth
+    vec2 radiusUV = vec2(projection[0][0], projection[1][1]) * 0.5 * radius / -fragPos.z;
+    vec2 texelSize = 1.0 / vec2(textureSize(gDepth, 0));
+    // full weight up to 40% of the radius, fading out to none at the radius
+    float falloffRange = 0.6 * radius;
+    float falloffMul = -1.0 / falloffRange;
+    float falloffAdd = (radius - falloffRange) / falloffRange + 1.0;
+
+    float visibility = 0.0;
+    vec3 bentNormal = vec3(0.0);
+    for (int slice = 0; slice < sliceCount; ++slice)
+    {
+        float phi = (float(slice) + rotation) * PI / float(sliceCount);
+        vec2 direction = vec2(cos(phi), sin(phi));
+
+        // the slice plane holds the view vector and the direction; the normal is projected onto it
+        vec3 directionVec = vec3(direction, 0.0);
+        vec3 orthoDirectionVec = normalize(directionVec - dot(directionVec, viewVec) * viewVec);
+        vec3 axisVec = normalize(cross(orthoDirectionVec, viewVec));
+        vec3 projectedNormal = normal - axisVec * dot(normal, axisVec);
+        float projectedNormalLength = length(projectedNormal);
+        float cosNormal = clamp(dot(projectedNormal, viewVec) / max(projectedNormalLength, 1e-4), 0.0, 1.0);
+        float n = sign(dot(orthoDirectionVec, projectedNormal)) * acos(cosNormal);
+
+        // horizons start at the tangent plane, side 0 along the direction, side 1 against it
+        float lowHorizonCos0 = cos(n + HALF_PI);
+        float lowHorizonCos1 = cos(n - HALF_PI);
+        float horizonCos0 = lowHorizonCos0;
+        float horizonCos1 = lowHorizonCos1;
+        for (int i = 0; i < stepCount; ++i)
+        {
+            // quadratic distribution: more samples close to the pixel, where occluders matter most
+            float s = (float(i) + jitter) / float(stepCount);
+            vec2 offset = direction * (s * s * radiusUV + texelSize);
+
+            vec2 uv0 = TexCoords + offset;
+            vec2 uv1 = TexCoords - offset;
+            vec3 delta0 = viewPositionFromDepth(texture(gDepth, uv0).r, uv0) - origin;
+            vec3 delta1 = viewPositionFromDepth(texture(gDepth, uv1).r, uv1) - origin;
+            float distance0 = length(delta0);
+            float distance1 = length(delta1);
+            float weight0 = clamp(distance0 * falloffMul + falloffAdd, 0.0, 1.0);
+            float weight1 = clamp(distance1 * falloffMul + falloffAdd, 0.0, 1.0);
+            float sampleCos0 = mix(lowHorizonCos0, dot(delta0, viewVec) / max(distance0, 1e-4), weight0);
+            float sampleCos1 = mix(lowHorizonCos1, dot(delta1, viewVec) / max(distance1, 1e-4), weight1);
+            horizonCos0 = max(horizonCos0, sampleCos0);
+            horizonCos1 = max(horizonCos1, sampleCos1);
+        }
+
+        // horizon angles, clamped to the hemisphere around the projected normal
+        float h0 = n + clamp(-acos(horizonCos1) - n, -HALF_PI, HALF_PI);
+        float h1 = n + clamp(acos(horizonCos0) - n, -HALF_PI, HALF_PI);
+        float sinN = sin(n);
+        float arc0 = (cosNormal + 2.0 * h0 * sinN - cos(2.0 * h0 - n)) / 4.0;
+        float arc1 = (cosNormal + 2.0 * h1 * sinN - cos(2.0 * h1 - n)) / 4.0;
+        visibility += projectedNormalLength * (arc0 + arc1);
+
+        // cosine weighted mean direction of the visible arc, in the slice's (direction, view) basis
+        float t0 = (6.0 * sin(h0 - n) - sin(3.0 * h0 - n) + 6.0 * sin(h1 - n) - sin(3.0 * h1 - n)
+                    + 16.0 * sinN - 3.0 * (sin(h0 + n) + sin(h1 + n))) / 12.0;
+        float t1 = (-cos(3.0 * h0 - n) - cos(3.0 * h1 - n) + 8.0 * cos(n) - 3.0 * (cos(h0 + n) + cos(h1 + n))) / 12.0;
+        bentNormal += (orthoDirectionVec * t0 + viewVec * t1) * projectedNormalLength;
+    }
+
+    visibility = clamp(visibility / float(sliceCount), 0.0, 1.0);
+    FragColor = vec4(pow(visibility, power), fragPos.z, encodeOctahedral(normal));
+    BentNormal = length(bentNormal) > 1e-4 ? normalize(bentNormal) : normal;
+}
@@ -0,0 +1,31 @@
+// Joint bilateral upsampling of a reduced resolution AO term packed with its guides (r occlusion, g view space
+// depth, ba octahedral normal): the four low resolution texels around the pixel are weighted by their bilinear
+// weight times how well their depth and normal match the full resolution pixel's, so occlusion computed on one
+// side of a silhouette does not bleed onto the other.
+#include "octahedral.glsl"
+
+float upsampleOcclusion(sampler2D occlusion, vec2 uv, vec3 position, vec3 normal)
+{
+    vec2 size = vec2(textureSize(occlusion, 0));
+    vec2 coord = uv * size - 0.5;
+    vec2 base = floor(coord);
+    vec2 f = coord - base;
+
+    float result = 0.0;
+    float weightSum = 0.0;
+    for (int i = 0; i < 4; ++i)
+    {
+        vec2 offset = vec2(i & 1, i >> 1);
+        vec4 tap = texelFetch(occlusion, clamp(ivec2(base + offset), ivec2(0), ivec2(size) - 1), 0);
+        vec2 bilinear = mix(1.0 - f, f, offset);
+        // relative depth difference, so the falloff does not depend on the distance to the camera
+        float depthDelta = abs(position.z - tap.g) / max(abs(position.z), 0.001);
+        float depthWeight = 1.0 / (0.001 + depthDelta);
+        float normalWeight = pow(max(dot(normal, decodeOctahedral(tap.ba)), 0.0), 8.0);
+        float weight = bilinear.x * bilinear.y * depthWeight * normalWeight;
+        result += tap.r * weight;
+        weightSum += weight;
+    }
+    // every neighbour rejected (thin geometry): fall back to the nearest value
+    return weightSum > 1e-4 ? result / weightSum : texture(occlusion, uv).r;
+}
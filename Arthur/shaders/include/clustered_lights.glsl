@@ -0,0 +1,50 @@
+// Point lights assigned to a froxel grid by ClusteredLights (ClusteredLights.h), in view space.
+// A fragment shades the lights of its cluster: clusterLightRange() then clusteredLight() for each index of the range.
+// permutation: CLUSTERED_LIGHTS_NAIVE shades every light instead, the reference the clusters are measured against
+#include "point_light.glsl"
+
+uniform usamplerBuffer clusterGrid;
+uniform usamplerBuffer clusterLightIndices;
+uniform samplerBuffer clusterLightData;
+// 0 when the grid was not built for this pass
+uniform int clusterLightCount;
+uniform vec3 clusterDimensions;
+// tiles per pixel, and the slice of a view depth: log(depth) * x - y
+uniform vec2 clusterTileScale;
+uniform vec2 clusterDepthParams;
+
+struct ClusteredLight
+{
+    vec3 position;
+    float radius;
+    vec3 color;
+};
+
+// First and end of the fragment's range of lights
+uvec2 clusterLightRange(vec2 fragCoord, float viewZ)
+{
+    if (clusterLightCount == 0)
+        return uvec2(0u);
+#ifdef CLUSTERED_LIGHTS_NAIVE
+    return uvec2(0u, uint(clusterLightCount));
+#else
+    ivec3 dimensions = ivec3(clusterDimensions);
+    ivec2 tile = clamp(ivec2(fragCoord * clusterTileScale), ivec2(0), dimensions.xy - 1);
+    int slice = clamp(int(floor(log(-viewZ) * clusterDepthParams.x - clusterDepthParams.y)), 0, dimensions.z - 1);
+    uvec2 list = texelFetch(clusterGrid, (slice * dimensions.y + tile.y) * dimensions.x + tile.x).rg;
+    return uvec2(list.x, list.x + list.y);
+#endif
+}
+
+ClusteredLight clusteredLight(uint index)
+{
+#ifndef CLUSTERED_LIGHTS_NAIVE
+    index = texelFetch(clusterLightIndices, int(index)).r;
+#endif
+    vec4 positionRadius = texelFetch(clusterLightData, int(index) * 2);
+    ClusteredLight light;
+    light.position = positionRadius.xyz;
+    light.radius = positionRadius.w;
+    light.color = texelFetch(clusterLightData, int(index) * 2 + 1).rgb;
+    return light;
+}
@@ -0,0 +1,9 @@
+// per-frame data of the main camera, uniform block binding 0
+layout (std140) uniform FrameBlock
+{
+    mat4 view;
+    mat4 projection;
+    vec3 camPos;
+    float time;
+    mat4 inverseProjection;
+};
@@ -0,0 +1,28 @@
+// Compact G-buffer written by model_geometry.frag, the view space position is rebuilt from the depth buffer:
+//   gNormal   RG16          octahedral view space normal, remapped to [0, 1]
+//   gAlbedo   SRGB8_ALPHA8  albedo, material ambient occlusion in alpha
+//   gMaterial RGBA8         metallic, roughness, specular intensity, flags
+#include "octahedral.glsl"
+
+// set on every pixel the geometry pass wrote, the lighting pass leaves the others black
+const uint GBUFFER_FLAG_SHADED = 1u;
+
+vec2 encodeGBufferNormal(vec3 normal)
+{
+    return encodeOctahedral(normalize(normal)) * 0.5 + 0.5;
+}
+
+vec3 decodeGBufferNormal(vec2 encoded)
+{
+    return decodeOctahedral(encoded * 2.0 - 1.0);
+}
+
+float encodeGBufferFlags(uint flags)
+{
+    return float(flags) / 255.0;
+}
+
+uint decodeGBufferFlags(float encoded)
+{
+    return uint(encoded * 255.0 + 0.5);
+}
@@ -0,0 +1,21 @@
+// Octahedral encoding of unit vectors into two components in [-1, 1], precise enough for 16 bit float targets
+vec2 octahedralWrap(vec2 v)
+{
+    return (1.0 - abs(v.yx)) * vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+}
+
+vec2 encodeOctahedral(vec3 n)
+{
+    // the empty background has a null normal, it decodes to +z
+    n /= max(abs(n.x) + abs(n.y) + abs(n.z), 1e-6);
+    return n.z >= 0.0 ? n.xy : octahedralWrap(n.xy);
+}
+
+vec3 decodeOctahedral(vec2 e)
+{
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = clamp(-n.z, 0.0, 1.0);
+    n.x += n.x >= 0.0 ? -t : t;
+    n.y += n.y >= 0.0 ? -t : t;
+    return normalize(n);
+}
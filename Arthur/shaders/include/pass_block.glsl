@@ -0,0 +1,7 @@
+// camera of the current pass, main view or cubemap capture, uniform block binding 1
+layout (std140) uniform PassBlock
+{
+    mat4 view;
+    mat4 projection;
+    vec3 viewPos;
+};
@@ -0,0 +1,27 @@
+// Point lights with a finite radius, shared by the clustered lights and the light volumes
+
+// Inverse square falloff windowed to reach zero at the radius, so a light does nothing outside of its sphere
+float pointLightAttenuation(float distance, float radius)
+{
+    float window = clamp(1.0 - pow(distance / radius, 4.0), 0.0, 1.0);
+    return window * window / (distance * distance + 1.0);
+}
+
+// Diffuse and Blinn-Phong specular of a G-buffer material under one point light, in view space;
+// the exponent matching the roughness as in model_lighting.frag, metals tinted by their albedo
+vec3 deferredPointLight(vec3 position, vec3 normal, vec3 albedo, vec3 material, vec3 lightPosition, float lightRadius, vec3 lightColor)
+{
+    vec3 toLight = lightPosition - position;
+    float distance = length(toLight);
+    if (distance >= lightRadius)
+        return vec3(0.0);
+    float metallic = material.r;
+    float roughness = material.g;
+    float specularLevel = material.b;
+    vec3 lightDir = toLight / distance;
+    vec3 halfwayDir = normalize(lightDir + normalize(-position));
+    float shininess = 2.0 / max(pow(roughness, 4.0), 1e-4) - 2.0;
+    vec3 diffuse = max(dot(normal, lightDir), 0.0) * albedo * (1.0 - metallic);
+    vec3 specular = pow(max(dot(normal, halfwayDir), 0.0), shininess) * mix(vec3(specularLevel), albedo, metallic);
+    return (diffuse + specular) * lightColor * pointLightAttenuation(distance, lightRadius);
+}
@@ -0,0 +1,19 @@
+// View space reconstruction from the depth buffer of the main camera, include after frame_block.glsl
+vec3 viewPositionFromDepth(float depth, vec2 uv)
+{
+    vec4 position = inverseProjection * vec4(vec3(uv, depth) * 2.0 - 1.0, 1.0);
+    return position.xyz / position.w;
+}
+
+// View space z alone, from the projection's two depth terms instead of the full inverse
+float viewDepthFromDepth(float depth)
+{
+    return -projection[3][2] / (depth * 2.0 - 1.0 + projection[2][2]);
+}
+
+// View space position from its z, for targets storing the view depth instead of the depth buffer value
+vec3 viewPositionFromViewDepth(float z, vec2 uv)
+{
+    vec2 ndc = uv * 2.0 - 1.0;
+    return vec3((ndc + vec2(projection[2][0], projection[2][1])) * -z / vec2(projection[0][0], projection[1][1]), z);
+}
@@ -2,8 +2,8 @@
 layout (location = 0) in vec3 aPos;
 
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+
+#include "include/pass_block.glsl"
 
 void main()
 {
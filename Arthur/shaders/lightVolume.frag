@@ -0,0 +1,34 @@
+#version 330 core
+// One point light added to the lit G-buffer, over the pixels its volume's stencil pass marked
+out vec4 FragColor;
+
+uniform sampler2D gDepth;
+uniform sampler2D gNormal;
+uniform sampler2D gAlbedo;
+uniform sampler2D gMaterial;
+
+#include "include/frame_block.glsl"
+#include "include/view_position.glsl"
+#include "include/gbuffer.glsl"
+#include "include/point_light.glsl"
+
+// the light, in view space
+uniform vec3 lightPosition;
+uniform float lightRadius;
+uniform vec3 lightColor;
+
+void main()
+{
+    vec2 uv = gl_FragCoord.xy / vec2(textureSize(gDepth, 0));
+    vec4 Material = texture(gMaterial, uv);
+    // no discard: the fragment must still reset the stencil
+    if ((decodeGBufferFlags(Material.a) & GBUFFER_FLAG_SHADED) == 0u)
+    {
+        FragColor = vec4(0.0);
+        return;
+    }
+    vec3 FragPos = viewPositionFromDepth(texture(gDepth, uv).r, uv);
+    vec3 Normal = decodeGBufferNormal(texture(gNormal, uv).rg);
+    vec3 Diffuse = texture(gAlbedo, uv).rgb;
+    FragColor = vec4(deferredPointLight(FragPos, Normal, Diffuse, Material.rgb, lightPosition, lightRadius, lightColor), 0.0);
+}
@@ -0,0 +1,12 @@
+#version 330 core
+// Sphere bounding a point light, drawn by the light volume passes
+layout (location = 0) in vec3 position;
+
+#include "include/frame_block.glsl"
+
+uniform mat4 model;
+
+void main()
+{
+    gl_Position = projection * view * model * vec4(position, 1.0);
+}
@@ -0,0 +1,5 @@
+#version 330 core
+// Stencil marking of a light volume: only the depth test and the stencil operations matter
+void main()
+{
+}
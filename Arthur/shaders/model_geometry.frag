@@ -1,38 +1,42 @@
 #version 330 core
 
-layout (location = 0) out vec3 gPosition;
-layout (location = 1) out vec3 gNormal;
-layout (location = 2) out vec4 gAlbedo;
+// layout and encodings in include/gbuffer.glsl
+layout (location = 0) out vec2 gNormal;
+layout (location = 1) out vec4 gAlbedo;
+layout (location = 2) out vec4 gMaterial;
 
 in vec2 TexCoords;
-in vec3 FragPos;
 in vec3 Normal;
 
 uniform sampler2D texture_diffuse1;
 uniform sampler2D texture_specular1;
 
-uniform bool ssaoActive;
+uniform float metallic;
+uniform float roughness;
+
+#include "include/gbuffer.glsl"
+
+// permutation: SSAO stores a constant albedo so the occlusion is the only visible shading
 
 void main()
 {
-	// Storing fragment position in first gBuffer texture
-	gPosition = FragPos;
-
 	// Storing normal into gBuffer
-	gNormal = normalize(Normal);
+	gNormal = encodeGBufferNormal(Normal);
 
-	if(ssaoActive)
+#ifdef SSAO
 	{
 		// And the diffuse per-fragment color
-	    gAlbedo.rgb = vec3(0.95);
+	    gAlbedo = vec4(vec3(0.95), 1.0);
+	    gMaterial = vec4(0.0, roughness, 0.0, encodeGBufferFlags(GBUFFER_FLAG_SHADED));
 	}
-	else
+#else
 	{
-		// Storing diffuse
-		gAlbedo.rgb = texture(texture_diffuse1, TexCoords).rgb;
+		// Storing diffuse, the model has no occlusion map
+		gAlbedo = vec4(texture(texture_diffuse1, TexCoords).rgb, 1.0);
 
-		// Storing specular
-		gAlbedo.a = texture(texture_specular1, TexCoords).r;
+		// Storing specular with the material parameters
+		gMaterial = vec4(metallic, roughness, texture(texture_specular1, TexCoords).r, encodeGBufferFlags(GBUFFER_FLAG_SHADED));
 	}
+#endif
 
-}
\ No newline at end of file
+}
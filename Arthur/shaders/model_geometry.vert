@@ -8,10 +8,10 @@ out vec2 TexCoords;
 out vec3 Normal;
 
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
 
-uniform bool invertedNormals;
+#include "include/frame_block.glsl"
+
+// permutation: INVERTED_NORMALS for geometry seen from the inside
 
 void main()
 {
@@ -20,7 +20,11 @@ void main()
     TexCoords = texCoords;
     
     mat3 normalMatrix = transpose(inverse(mat3(view * model)));
-    Normal = normalMatrix * (invertedNormals ? -normal : normal);
+#ifdef INVERTED_NORMALS
+    Normal = normalMatrix * -normal;
+#else
+    Normal = normalMatrix * normal;
+#endif
     
     gl_Position = projection * worldPos;
 }
\ No newline at end of file
@@ -2,15 +2,30 @@
 out vec4 FragColor;
 in vec2 TexCoords;
 
-uniform sampler2D gPosition;
+uniform sampler2D gDepth;
 uniform sampler2D gNormal;
 uniform sampler2D gAlbedo;
+uniform sampler2D gMaterial;
 uniform sampler2D ssao;
 
-uniform bool ssaoActive;
-uniform bool deferredActive;
+// permutation: SSAO lights with the occlusion texture, otherwise with the specular stored in gAlbedo.a
+// permutation: SSAO_UPSAMPLE when the occlusion was computed at half or quarter resolution
+#ifdef SSAO_UPSAMPLE
+#include "include/bilateral_upsample.glsl"
+#endif
+// permutation: SSAO_BENT_NORMALS when the occlusion pass (GTAO) also wrote the view space bent normals
+#ifdef SSAO_BENT_NORMALS
+uniform sampler2D ssaoBentNormal;
+#endif
 
-uniform vec3 viewPos;
+// permutation: CLUSTERED_LIGHTS adds the point lights of the fragment's cluster to the light above
+#ifdef CLUSTERED_LIGHTS
+#include "include/clustered_lights.glsl"
+#endif
+
+#include "include/frame_block.glsl"
+#include "include/view_position.glsl"
+#include "include/gbuffer.glsl"
 
 struct Light {
     vec3 Position;
@@ -24,17 +39,28 @@ uniform Light light;
 void main()
 {             
     // Retrieve data from gbuffer
-    vec3 FragPos = texture(gPosition, TexCoords).rgb;
-    vec3 Normal = texture(gNormal, TexCoords).rgb;
-    vec3 Diffuse = texture(gAlbedo, TexCoords).rgb;
+    vec3 FragPos = viewPositionFromDepth(texture(gDepth, TexCoords).r, TexCoords);
+    vec3 Normal = decodeGBufferNormal(texture(gNormal, TexCoords).rg);
+    vec4 AlbedoOcclusion = texture(gAlbedo, TexCoords);
+    vec3 Diffuse = AlbedoOcclusion.rgb;
+    vec4 Material = texture(gMaterial, TexCoords);
+    if ((decodeGBufferFlags(Material.a) & GBUFFER_FLAG_SHADED) == 0u)
+    {
+        FragColor = vec4(0.0, 0.0, 0.0, 1.0);
+        return;
+    }
     vec3 lighting;
 
-    if(ssaoActive)
+#ifdef SSAO
     {
+#ifdef SSAO_UPSAMPLE
+        float AmbientOcclusion = upsampleOcclusion(ssao, TexCoords, FragPos, Normal);
+#else
         float AmbientOcclusion = texture(ssao, TexCoords).r;
+#endif
         
         // then calculate lighting as usual
-        vec3 ambient = vec3(0.8 * Diffuse * AmbientOcclusion);
+        vec3 ambient = vec3(0.8 * Diffuse * AmbientOcclusion * AlbedoOcclusion.a);
         lighting  = ambient; 
         vec3 viewDir  = normalize(-FragPos); // viewpos is (0.0.0)
         // diffuse
@@ -49,22 +75,34 @@ void main()
         float attenuation = 1.0 / (1.0 + light.Linear * distance + light.Quadratic * distance * distance);
         diffuse *= attenuation;
         specular *= attenuation;
+#ifdef SSAO_BENT_NORMALS
+        // the visible directions form a cone around the bent normal; a cone of cosine weighted visibility AO
+        // has cos(half angle) = sqrt(1 - AO), lights outside of it are occluded
+        vec3 BentNormal = normalize(texture(ssaoBentNormal, TexCoords).xyz);
+        float cosAperture = sqrt(clamp(1.0 - AmbientOcclusion, 0.0, 1.0));
+        float lightVisibility = smoothstep(cosAperture - 0.2, cosAperture + 0.2, dot(BentNormal, lightDir));
+        diffuse *= lightVisibility;
+        specular *= lightVisibility;
+#endif
         lighting += diffuse + specular;
     }
-    else
+#else
     {
-        float Specular = texture(gAlbedo, TexCoords).a;
+        float Metallic = Material.r;
+        float Roughness = Material.g;
+        float Specular = Material.b;
     
         // Then calculate lighting as usual
-        lighting  = Diffuse * 0.1; // hard-coded ambient component
-        vec3 viewDir  = normalize(viewPos - FragPos);
+        lighting  = Diffuse * 0.1 * AlbedoOcclusion.a; // hard-coded ambient component
+        vec3 viewDir  = normalize(camPos - FragPos);
         // Diffuse
         vec3 lightDir = normalize(light.Position - FragPos);
-        vec3 diffuse = max(dot(Normal, lightDir), 0.0) * Diffuse * light.Color;
-        // Specular
+        vec3 diffuse = max(dot(Normal, lightDir), 0.0) * Diffuse * light.Color * (1.0 - Metallic);
+        // Specular, metals tinted by their albedo; the Blinn-Phong exponent matching a roughness, 16 at 0.58
         vec3 halfwayDir = normalize(lightDir + viewDir);  
-        float spec = pow(max(dot(Normal, halfwayDir), 0.0), 16.0);
-        vec3 specular = light.Color * spec * Specular;
+        float shininess = 2.0 / max(pow(Roughness, 4.0), 1e-4) - 2.0;
+        float spec = pow(max(dot(Normal, halfwayDir), 0.0), shininess);
+        vec3 specular = light.Color * spec * mix(vec3(Specular), Diffuse, Metallic);
         // Attenuation
         float distance = length(light.Position - FragPos);
         float attenuation = 1.0 / (1.0 + light.Linear * distance + light.Quadratic * distance * distance);
@@ -72,6 +110,18 @@ void main()
         specular *= attenuation;
         lighting += diffuse + specular;
     }
+#endif
+
+#ifdef CLUSTERED_LIGHTS
+    {
+        uvec2 range = clusterLightRange(gl_FragCoord.xy, FragPos.z);
+        for (uint i = range.x; i < range.y; ++i)
+        {
+            ClusteredLight point = clusteredLight(i);
+            lighting += deferredPointLight(FragPos, Normal, Diffuse, Material.rgb, point.position, point.radius, point.color);
+        }
+    }
+#endif
     
     FragColor = vec4(lighting, 1.0);
 }
\ No newline at end of file
@@ -34,8 +34,8 @@ uniform vec3 objectColor;
 uniform vec3 lightColor;
 uniform vec3 lightPos;
 uniform vec3 lightIntensity;
-uniform vec3 viewPos;
-uniform int lightMode;
+#include "include/frame_block.glsl"
+// permutation: DIRECTIONAL_LIGHT lights along light.direction, otherwise from the point light at lightPos
 //uniform mat4 view;
 
 void main()
@@ -44,20 +44,21 @@ void main()
     vec3 norm = normalize(Normal);
     vec3 lightDir;
 
-    if(lightMode == 1)
-    {
-    	lightDir = normalize(lightPos - FragPos);
-    }
-    else
-    {
-    	lightDir = normalize(-light.direction);
-    }
-    vec3 viewDir = normalize(viewPos - FragPos);
+#ifdef DIRECTIONAL_LIGHT
+    lightDir = normalize(-light.direction);
+#else
+    lightDir = normalize(lightPos - FragPos);
+#endif
+    vec3 viewDir = normalize(camPos - FragPos);
     vec3 reflectDir = reflect(-lightDir, norm);
 
-    // Attenuation
+    // Attenuation, directional lights have none
+#ifdef DIRECTIONAL_LIGHT
+    float attenuation = 1.0f;
+#else
     float distance = length(lightPos - FragPos);
     float attenuation = 1.0f / (light.constant + light.linear * distance + light.quadratic * (distance * distance));
+#endif
 
 	// Ambient 
     vec3 ambient = material.ambient * lightColor;
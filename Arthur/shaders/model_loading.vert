@@ -9,8 +9,8 @@ out vec2 TexCoords;
 out vec3 FragPos;
 
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+
+#include "include/frame_block.glsl"
 
 void main()
 {
@@ -3,12 +3,12 @@ in vec3 Normal;
 in vec3 Position;
 out vec4 color;
 
-uniform vec3 cameraPos;
+#include "include/frame_block.glsl"
 uniform samplerCube skybox;
 
 void main()
 {
-	vec3 I = normalize(Position - cameraPos);
+	vec3 I = normalize(Position - camPos);
 	vec3 R = reflect(I,normalize(Normal));
 	color = texture(skybox, R);
 }
\ No newline at end of file
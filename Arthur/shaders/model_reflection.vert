@@ -6,8 +6,8 @@ out vec3 Normal;
 out vec3 Position;
 
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+
+#include "include/frame_block.glsl"
 
 void main()
 {
@@ -1,4 +1,5 @@
 #version 330 core
+#extension GL_ARB_texture_cube_map_array : enable
 out vec4 FragColor;
 in vec2 TexCoords;
 in vec3 WorldPos;
@@ -16,13 +17,25 @@ uniform samplerCube irradianceMap;
 uniform samplerCube prefilterMap;
 uniform sampler2D brdfLUT;
 
+// local reflection probes, blended over the global prefiltered environment
+#define MAX_PROBES 4
+uniform int probeCount;
+uniform vec3 probePositions[MAX_PROBES];
+uniform vec3 probeBoxMin[MAX_PROBES];
+uniform vec3 probeBoxMax[MAX_PROBES];
+#ifdef GL_ARB_texture_cube_map_array
+uniform samplerCubeArray probeMap;
+#endif
+
 // lights
 uniform vec3 lightPositions[4];
 uniform vec3 lightColors[4];
 
-uniform vec3 camPos;
+#include "include/pass_block.glsl"
 
-const float PI = 3.14159265359;
+#include "include/brdf.glsl"
+// point lights of the main view's clusters, none in the reflection probe captures
+#include "include/clustered_lights.glsl"
 // ----------------------------------------------------------------------------
 // Easy trick to get tangent-normals to world-space to keep PBR code simplified.
 // Don't worry if you don't get what's going on; you generally want to do normal 
@@ -45,51 +58,75 @@ vec3 getNormalFromMap()
     return normalize(TBN * tangentNormal);
 }
 // ----------------------------------------------------------------------------
-float DistributionGGX(vec3 N, vec3 H, float roughness)
+// Prefiltered radiance along R: probes whose box contains the fragment are blended by how deep inside
+// their box it is, with R box projected so the reflection lines up with the captured geometry.
+vec3 sampleReflection(vec3 R, float lod)
 {
-    float a = roughness*roughness;
-    float a2 = a*a;
-    float NdotH = max(dot(N, H), 0.0);
-    float NdotH2 = NdotH*NdotH;
-
-    float nom   = a2;
-    float denom = (NdotH2 * (a2 - 1.0) + 1.0);
-    denom = PI * denom * denom;
-
-    return nom / denom;
+    vec3 color = vec3(0.0);
+    float totalWeight = 0.0;
+#ifdef GL_ARB_texture_cube_map_array
+    for(int i = 0; i < probeCount; ++i)
+    {
+        vec3 boxMin = probeBoxMin[i];
+        vec3 boxMax = probeBoxMax[i];
+
+        // fade out over the outer 20% of the box
+        vec3 local = abs(WorldPos - 0.5 * (boxMin + boxMax)) / (0.5 * (boxMax - boxMin));
+        float weight = clamp((1.0 - max(max(local.x, local.y), local.z)) * 5.0, 0.0, 1.0);
+        if(weight <= 0.0)
+            continue;
+
+        // intersect the reflection ray with the box and look the hit point up from the probe's position
+        vec3 first = (boxMax - WorldPos) / R;
+        vec3 second = (boxMin - WorldPos) / R;
+        vec3 furthest = max(first, second);
+        float distance = min(min(furthest.x, furthest.y), furthest.z);
+        vec3 direction = WorldPos + R * distance - probePositions[i];
+
+        color += weight * textureLod(probeMap, vec4(direction, float(i)), lod).rgb;
+        totalWeight += weight;
+    }
+    if(totalWeight > 1.0)
+    {
+        color /= totalWeight;
+        totalWeight = 1.0;
+    }
+#endif
+    // the global environment fills in where the probes don't fully cover the fragment
+    return color + (1.0 - totalWeight) * textureLod(prefilterMap, R, lod).rgb;
 }
 // ----------------------------------------------------------------------------
-float GeometrySchlickGGX(float NdotV, float roughness)
+// Outgoing radiance of one light: Cook-Torrance specular and Lambert diffuse, weighted by N.L
+vec3 shadeLight(vec3 N, vec3 V, vec3 L, vec3 radiance, vec3 albedo, float metallic, float roughness, vec3 F0)
 {
-    float r = (roughness + 1.0);
-    float k = (r*r) / 8.0;
-
-    float nom   = NdotV;
-    float denom = NdotV * (1.0 - k) + k;
+    vec3 H = normalize(V + L);
 
-    return nom / denom;
-}
-// ----------------------------------------------------------------------------
-float GeometrySmith(vec3 N, vec3 V, vec3 L, float roughness)
-{
-    float NdotV = max(dot(N, V), 0.0);
-    float NdotL = max(dot(N, L), 0.0);
-    float ggx2 = GeometrySchlickGGX(NdotV, roughness);
-    float ggx1 = GeometrySchlickGGX(NdotL, roughness);
+    // Cook-Torrance BRDF
+    float NDF = DistributionGGX(N, H, roughness);   
+    float G   = GeometrySmith(N, V, L, roughness);    
+    vec3 F    = fresnelSchlick(max(dot(H, V), 0.0), F0);        
+    
+    vec3 nominator    = NDF * G * F;
+    float denominator = 4 * max(dot(N, V), 0.0) * max(dot(N, L), 0.0) + 0.001; // 0.001 to prevent divide by zero.
+    vec3 specular = nominator / denominator;
+    
+     // kS is equal to Fresnel
+    vec3 kS = F;
+    // for energy conservation, the diffuse and specular light can't
+    // be above 1.0 (unless the surface emits light); to preserve this
+    // relationship the diffuse component (kD) should equal 1.0 - kS.
+    vec3 kD = vec3(1.0) - kS;
+    // multiply kD by the inverse metalness such that only non-metals 
+    // have diffuse lighting, or a linear blend if partly metal (pure metals
+    // have no diffuse light).
+    kD *= 1.0 - metallic;                   
+        
+    // scale light by NdotL
+    float NdotL = max(dot(N, L), 0.0);        
 
-    return ggx1 * ggx2;
-}
-// ----------------------------------------------------------------------------
-vec3 fresnelSchlick(float cosTheta, vec3 F0)
-{
-    return F0 + (1.0 - F0) * pow(1.0 - cosTheta, 5.0);
+    return (kD * albedo / PI + specular) * radiance * NdotL; // note that we already multiplied the BRDF by the Fresnel (kS) so we won't multiply by kS again
 }
 // ----------------------------------------------------------------------------
-vec3 fresnelSchlickRoughness(float cosTheta, vec3 F0, float roughness)
-{
-    return F0 + (max(vec3(1.0 - roughness), F0) - F0) * pow(1.0 - cosTheta, 5.0);
-}   
-// ----------------------------------------------------------------------------
 void main()
 {       
     // material properties
@@ -100,7 +137,7 @@ void main()
        
     // input lighting data
     vec3 N = getNormalFromMap();
-    vec3 V = normalize(camPos - WorldPos);
+    vec3 V = normalize(viewPos - WorldPos);
     vec3 R = reflect(-V, N); 
 
     // calculate reflectance at normal incidence; if dia-electric (like plastic) use F0 
@@ -114,37 +151,32 @@ void main()
     {
         // calculate per-light radiance
         vec3 L = normalize(lightPositions[i] - WorldPos);
-        vec3 H = normalize(V + L);
         float distance = length(lightPositions[i] - WorldPos);
         float attenuation = 1.0 / (distance * distance);
         vec3 radiance = lightColors[i] * attenuation;
 
-        // Cook-Torrance BRDF
-        float NDF = DistributionGGX(N, H, roughness);   
-        float G   = GeometrySmith(N, V, L, roughness);    
-        vec3 F    = fresnelSchlick(max(dot(H, V), 0.0), F0);        
-        
-        vec3 nominator    = NDF * G * F;
-        float denominator = 4 * max(dot(N, V), 0.0) * max(dot(N, L), 0.0) + 0.001; // 0.001 to prevent divide by zero.
-        vec3 specular = nominator / denominator;
-        
-         // kS is equal to Fresnel
-        vec3 kS = F;
-        // for energy conservation, the diffuse and specular light can't
-        // be above 1.0 (unless the surface emits light); to preserve this
-        // relationship the diffuse component (kD) should equal 1.0 - kS.
-        vec3 kD = vec3(1.0) - kS;
-        // multiply kD by the inverse metalness such that only non-metals 
-        // have diffuse lighting, or a linear blend if partly metal (pure metals
-        // have no diffuse light).
-        kD *= 1.0 - metallic;                   
-            
-        // scale light by NdotL
-        float NdotL = max(dot(N, L), 0.0);        
-
         // add to outgoing radiance Lo
-        Lo += (kD * albedo / PI + specular) * radiance * NdotL; // note that we already multiplied the BRDF by the Fresnel (kS) so we won't multiply by kS again
+        Lo += shadeLight(N, V, L, radiance, albedo, metallic, roughness, F0);
     }   
+
+    // the clustered lights are in view space, the BRDF only depends on the angles between the vectors
+    vec3 viewPosition = vec3(view * vec4(WorldPos, 1.0));
+    uvec2 range = clusterLightRange(gl_FragCoord.xy, viewPosition.z);
+    if (range.y > range.x)
+    {
+        vec3 viewN = mat3(view) * N;
+        vec3 viewV = normalize(-viewPosition);
+        for (uint i = range.x; i < range.y; ++i)
+        {
+            ClusteredLight point = clusteredLight(i);
+            vec3 toLight = point.position - viewPosition;
+            float distance = length(toLight);
+            if (distance >= point.radius)
+                continue;
+            vec3 radiance = point.color * pointLightAttenuation(distance, point.radius);
+            Lo += shadeLight(viewN, viewV, toLight / distance, radiance, albedo, metallic, roughness, F0);
+        }
+    }
     
     // ambient lighting (we now use IBL as the ambient term)
     vec3 F = fresnelSchlickRoughness(max(dot(N, V), 0.0), F0, roughness);
@@ -158,10 +190,20 @@ void main()
     
     // sample both the pre-filter map and the BRDF lut and combine them together as per the Split-Sum approximation to get the IBL specular part.
     const float MAX_REFLECTION_LOD = 4.0;
-    vec3 prefilteredColor = textureLod(prefilterMap, R,  roughness * MAX_REFLECTION_LOD).rgb;    
-    vec2 brdf  = texture(brdfLUT, vec2(max(dot(N, V), 0.0), roughness)).rg;
+    vec3 prefilteredColor = sampleReflection(R, roughness * MAX_REFLECTION_LOD);
+    vec3 brdf  = texture(brdfLUT, vec2(max(dot(N, V), 0.0), roughness)).rgb;
     vec3 specular = prefilteredColor * (F * brdf.x + brdf.y);
 
+#ifdef MULTISCATTER
+    // energy lost to single scattering comes back as a diffuse-like lobe tinted by the average Fresnel (Kulla-Conty);
+    // the LUT carries Eavg in .b
+    float Ess = brdf.x + brdf.y;
+    float Eavg = brdf.z;
+    vec3 Favg = F0 + (1.0 - F0) / 21.0;
+    vec3 Fms = Favg * Favg * Eavg / (1.0 - Favg * (1.0 - Eavg));
+    specular += (1.0 - Ess) * Fms * irradiance;
+#endif
+
     vec3 ambient = (kD * diffuse + specular) * ao;
     
     vec3 color = ambient + Lo;
@@ -3,6 +3,9 @@ out vec4 FragColor;
 in vec3 WorldPos;
 
 uniform sampler2D equirectangularMap;
+// sIBL EVmulti/EVgamma (or REFmulti/REFgamma) of the map being converted
+uniform float multiplier;
+uniform float gamma;
 
 const vec2 invAtan = vec2(0.1591, 0.3183);
 vec2 SampleSphericalMap(vec3 v)
@@ -17,6 +20,8 @@ void main()
 {		
     vec2 uv = SampleSphericalMap(normalize(WorldPos));
     vec3 color = texture(equirectangularMap, uv).rgb;
+    // the map was balanced for display at the given gamma, remap it to the 2.2 gamma of the final output
+    color = multiplier * pow(color, vec3(2.2 / gamma));
     
     FragColor = vec4(color, 1.0);
 }
\ No newline at end of file
@@ -3,8 +3,7 @@ layout (location = 0) in vec3 aPos;
 
 out vec3 WorldPos;
 
-uniform mat4 projection;
-uniform mat4 view;
+#include "include/pass_block.glsl"
 
 void main()
 {
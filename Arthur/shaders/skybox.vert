@@ -2,12 +2,12 @@
 layout (location = 0) in vec3 position;
 out vec3 TexCoords;
 
-uniform mat4 projection;
-uniform mat4 view;
+#include "include/frame_block.glsl"
 
 void main()
 {
-    vec4 pos =   projection * view * vec4(position, 1.0);  
+    // remove the translation of the view so the skybox stays centered on the camera
+    vec4 pos =   projection * mat4(mat3(view)) * vec4(position, 1.0);  
     gl_Position = pos.xyww;
     TexCoords = position;
 }  
\ No newline at end of file
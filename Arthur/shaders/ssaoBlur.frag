@@ -1,21 +1,43 @@
 #version 330 core
-out float FragColor;
+// One direction of the separable bilateral blur of the packed SSAO target (r occlusion, g view space depth,
+// ba octahedral normal), run horizontally then vertically. Taps are weighted by a gaussian and by how well
+// their depth and normal match the center's, so occlusion does not bleed across silhouettes; each tap is a
+// single fetch, 2 * (2 * radius + 1) per pixel over both passes.
+out vec4 FragColor;
 
 in vec2 TexCoords;
 
 uniform sampler2D ssaoInput;
+// (1, 0) for the horizontal pass, (0, 1) for the vertical one
+uniform vec2 direction;
+uniform int radius;
+
+#include "include/octahedral.glsl"
+
+// how fast the weight falls with the relative depth difference
+const float depthSharpness = 50.0;
 
 void main() 
 {
-    vec2 texelSize = 1.0 / vec2(textureSize(ssaoInput, 0));
+    ivec2 texel = ivec2(gl_FragCoord.xy);
+    ivec2 size = textureSize(ssaoInput, 0);
+    vec4 center = texelFetch(ssaoInput, texel, 0);
+    vec3 centerNormal = decodeOctahedral(center.ba);
+    float sigma = max(float(radius) * 0.5, 0.5);
+
     float result = 0.0;
-    for (int x = -2; x < 2; ++x) 
+    float weightSum = 0.0;
+    for (int i = -radius; i <= radius; ++i)
     {
-        for (int y = -2; y < 2; ++y) 
-        {
-            vec2 offset = vec2(float(x), float(y)) * texelSize;
-            result += texture(ssaoInput, TexCoords + offset).r;
-        }
+        vec4 tap = texelFetch(ssaoInput, clamp(texel + ivec2(direction) * i, ivec2(0), size - 1), 0);
+        float spatialWeight = exp(-float(i * i) / (2.0 * sigma * sigma));
+        float depthDelta = abs(center.g - tap.g) / max(abs(center.g), 0.001);
+        float depthWeight = exp(-depthDelta * depthSharpness);
+        float normalWeight = pow(max(dot(centerNormal, decodeOctahedral(tap.ba)), 0.0), 8.0);
+        float weight = spatialWeight * depthWeight * normalWeight;
+        result += tap.r * weight;
+        weightSum += weight;
     }
-    FragColor = result / (4.0 * 4.0);
-}  
\ No newline at end of file
+    // the guides are passed through for the next pass and the upsample
+    FragColor = vec4(weightSum > 1e-4 ? result / weightSum : center.r, center.gba);
+}
@@ -0,0 +1,39 @@
+#version 330 core
+// Reduced resolution copy of the depth and normal for half and quarter resolution SSAO.
+// Every output texel keeps one real sample of the 2x2 texels at the center of its block, the nearest one
+// and the farthest one alternating in a checkerboard, so both sides of a silhouette survive the downsample
+// and no depth is ever averaged across an edge.
+layout (location = 0) out float ssaoDepth;
+// encoded like the gbuffer's normal, copied as is
+layout (location = 1) out vec2 ssaoNormal;
+
+in vec2 TexCoords;
+
+uniform sampler2D gDepth;
+uniform sampler2D gNormal;
+// full resolution texels per output texel along each axis: 2 or 4
+uniform int scale;
+
+void main()
+{
+    ivec2 texel = ivec2(gl_FragCoord.xy);
+    ivec2 base = texel * scale + ivec2(scale / 2 - 1);
+    bool nearest = ((texel.x + texel.y) & 1) == 0;
+
+    ivec2 chosen = base;
+    float chosenDepth = texelFetch(gDepth, base, 0).r;
+    for (int i = 1; i < 4; ++i)
+    {
+        ivec2 candidate = base + ivec2(i & 1, i >> 1);
+        float depth = texelFetch(gDepth, candidate, 0).r;
+        if (nearest ? depth < chosenDepth : depth > chosenDepth)
+        {
+            chosen = candidate;
+            chosenDepth = depth;
+        }
+    }
+
+    // the depth stays a depth buffer value, the occlusion rebuilds positions from it at this texel's center
+    ssaoDepth = chosenDepth;
+    ssaoNormal = texelFetch(gNormal, chosen, 0).rg;
+}
@@ -1,36 +1,55 @@
 #version 330 core
-out float FragColor;
+// occlusion packed with the guides of the bilateral blur and upsample: r occlusion, g view space depth, ba octahedral normal
+out vec4 FragColor;
 in vec2 TexCoords;
 
-uniform sampler2D gPosition;
+// depth buffer, or its reduced resolution copy
+uniform sampler2D gDepth;
 uniform sampler2D gNormal;
 uniform sampler2D texNoise;
 
-uniform int num_samples;
-uniform vec3 samples[64];
-uniform mat4 projection;
+#include "include/frame_block.glsl"
+#include "include/view_position.glsl"
+// SSAO sample kernel, uploaded once, uniform block binding 2
+layout (std140) uniform SsaoKernelBlock
+{
+    vec4 samples[64];
+};
 
 uniform int kernelSize;
 uniform float radius;
 uniform float bias;
 uniform int power;
 
-const vec2 noiseScale = vec2(1280.0/4.0 , 720.0/4.0);
+// tiles the 4x4 noise texture once every 4 texels of the SSAO target, whatever its resolution
+uniform vec2 noiseScale;
+// per frame offsets of the temporal accumulation, 0 without it: a fraction of a turn of the kernel in x, and in y
+// which of the interleaved subsets of the kernel is taken
+uniform vec2 temporalOffset;
+
+#include "include/gbuffer.glsl"
 
 void main()
 {
-	vec3 fragPos = texture(gPosition,TexCoords).xyz;
-	vec3 normal = texture(gNormal, TexCoords).rgb;
+	vec3 fragPos = viewPositionFromDepth(texture(gDepth, TexCoords).r, TexCoords);
+	vec3 normal = decodeGBufferNormal(texture(gNormal, TexCoords).rg);
 	vec3 randomVec = texture(texNoise, TexCoords * noiseScale).xyz;
+	float angle = temporalOffset.x * 6.28318530718;
+	randomVec.xy = mat2(cos(angle), sin(angle), -sin(angle), cos(angle)) * randomVec.xy;
 
 	vec3 tangent = normalize(randomVec - normal * dot(randomVec,normal));
 	vec3 biTangent = cross(normal, tangent);
 	mat3 TBN = mat3(tangent, biTangent, normal);
 
 	float occlusion = 0.0;
-	for(int i = 0 ; i < kernelSize; i++)
+	// the kernel block holds 64 samples, scaled closer to the center the lower their index: a smaller kernel takes
+	// every stride-th one so it spans the whole radius, and the frames cycle through the strides' offsets
+	int sampleCount = clamp(kernelSize, 1, 64);
+	int stride = 64 / sampleCount;
+	int first = min(int(temporalOffset.y * stride), stride - 1);
+	for(int i = 0 ; i < sampleCount; i++)
 	{
-		vec3 sample = TBN * samples[i];
+		vec3 sample = TBN * samples[i * stride + first].xyz;
 		sample = fragPos + sample * radius;
 
 		vec4 offset = vec4(sample, 1.0);
@@ -38,12 +57,12 @@ void main()
 		offset.xyz/=offset.w;
 		offset.xyz = offset.xyz * 0.5 + 0.5;
 
-		float sampleDepth = texture(gPosition, offset.xy).z;
+		float sampleDepth = viewDepthFromDepth(texture(gDepth, offset.xy).r);
 
 		float rangeCheck = smoothstep(0.0,1.0,radius/abs(fragPos.z - sampleDepth));
 		occlusion += (sampleDepth >= sample.z + bias ? 1.0 : 0.0) * rangeCheck;
 	}
 
-	occlusion = 1.0 - (occlusion/kernelSize);
-	FragColor = pow(occlusion,power);
+	occlusion = 1.0 - (occlusion/sampleCount);
+	FragColor = vec4(pow(occlusion,power), fragPos.z, encodeOctahedral(normal));
 }
\ No newline at end of file
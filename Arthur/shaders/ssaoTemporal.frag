@@ -0,0 +1,41 @@
+#version 330 core
+// Temporal accumulation of the packed occlusion (r occlusion, g view space depth, ba octahedral normal). Each pixel
+// is reprojected into the previous frame's accumulation, which is blended with this frame's occlusion unless it fell
+// off screen or its depth does not match (a disocclusion). The occlusion passes rotate their samples every frame,
+// so the history keeps gathering new ones: a few samples per frame add up to many.
+out vec4 FragColor;
+
+in vec2 TexCoords;
+
+uniform sampler2D ssaoInput;
+uniform sampler2D ssaoHistory;
+// this frame's view space to the previous frame's, and the previous projection
+uniform mat4 viewToPreviousView;
+uniform mat4 previousProjection;
+// weight of this frame, 1 without a usable history
+uniform float blend;
+
+#include "include/frame_block.glsl"
+#include "include/view_position.glsl"
+
+// relative depth difference from which the history is rejected
+const float depthTolerance = 0.05;
+
+void main()
+{
+    vec4 current = texelFetch(ssaoInput, ivec2(gl_FragCoord.xy), 0);
+    vec3 position = viewPositionFromViewDepth(current.g, TexCoords);
+    vec3 previousPosition = (viewToPreviousView * vec4(position, 1.0)).xyz;
+    vec4 previousClip = previousProjection * vec4(previousPosition, 1.0);
+    vec2 previousUV = previousClip.xy / previousClip.w * 0.5 + 0.5;
+
+    float weight = blend;
+    if (any(lessThan(previousUV, vec2(0.0))) || any(greaterThan(previousUV, vec2(1.0))))
+        weight = 1.0;
+    vec4 history = texture(ssaoHistory, previousUV);
+    if (abs(history.g - previousPosition.z) > depthTolerance * abs(previousPosition.z))
+        weight = 1.0;
+
+    // the guides stay this frame's, the blur and the upsample follow the current geometry
+    FragColor = vec4(mix(history.r, current.r, weight), current.gba);
+}
@@ -0,0 +1,28 @@
+#version 330 core
+// Upscale of the reduced resolution scene to the backbuffer: a bilinear fetch sharpened with a contrast adaptive
+// filter (after AMD's CAS). The four neighbours one source texel away form a negative lobe whose weight falls
+// where the neighbourhood already spans the whole range, so edges are restored without ringing.
+out vec4 FragColor;
+
+in vec2 TexCoords;
+
+uniform sampler2D scene;
+// 0 plain bilinear, 1 strongest
+uniform float sharpness;
+
+void main()
+{
+    vec2 texel = 1.0 / vec2(textureSize(scene, 0));
+    vec3 center = texture(scene, TexCoords).rgb;
+    vec3 north = texture(scene, TexCoords + vec2(0.0, texel.y)).rgb;
+    vec3 south = texture(scene, TexCoords - vec2(0.0, texel.y)).rgb;
+    vec3 east = texture(scene, TexCoords + vec2(texel.x, 0.0)).rgb;
+    vec3 west = texture(scene, TexCoords - vec2(texel.x, 0.0)).rgb;
+
+    vec3 minimum = min(center, min(min(north, south), min(east, west)));
+    vec3 maximum = max(center, max(max(north, south), max(east, west)));
+    vec3 amount = sqrt(clamp(min(minimum, 1.0 - maximum) / max(maximum, vec3(1e-4)), 0.0, 1.0));
+    vec3 weight = -amount * sharpness * 0.2;
+
+    FragColor = vec4(clamp((center + (north + south + east + west) * weight) / (1.0 + 4.0 * weight), 0.0, 1.0), 1.0);
+}
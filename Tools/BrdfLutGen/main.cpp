@@ -0,0 +1,53 @@
+// BRDFLUTGEN
+// Offline generator for the split-sum BRDF lookup table used by Arthur's PBR pipeline
+// Usage: BrdfLutGen [output] [-size N] [-samples N] [-singlescatter]
+// Run from the Arthur directory to overwrite images/brdfLUT.bin; the LUT carries the multiple scattering term the
+// PBR shader's energy compensation needs unless -singlescatter leaves it out
+
+// ================================
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+#include "../../Arthur/BrdfLut.h"
+
+int main(int argc, char** argv)
+{
+    std::string output = "images/brdfLUT.bin";
+    unsigned int size = 128;
+    unsigned int samples = 1024;
+    bool multiScatter = true;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (std::strcmp(argv[i], "-size") == 0 && i + 1 < argc)
+            size = std::atoi(argv[++i]);
+        else if (std::strcmp(argv[i], "-samples") == 0 && i + 1 < argc)
+            samples = std::atoi(argv[++i]);
+        else if (std::strcmp(argv[i], "-singlescatter") == 0)
+            multiScatter = false;
+        // the default now, still accepted
+        else if (std::strcmp(argv[i], "-multiscatter") == 0)
+            multiScatter = true;
+        else
+            output = argv[i];
+    }
+
+    std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+
+    BrdfLut lut;
+    lut.generate(size, multiScatter, samples);
+    if (!lut.write(output))
+    {
+        std::cerr << "ERROR::BRDFLUTGEN::FAILED_WRITING " << output << std::endl;
+        return 1;
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+    std::cout << "Wrote " << size << "x" << size << "x" << lut.channels << " BRDF LUT (" << samples << " samples) to " << output
+              << " in " << seconds << "s" << std::endl;
+    return 0;
+}
@@ -0,0 +1,96 @@
+// CUBEMAPCONVERT
+// Packs the six JPG faces of a skybox into a single cubemap container loaded by Skybox::configureSkybox
+// Usage: CubemapConvert <skybox folder> [output] [-rgb8] [-nomips]
+// Run from the Arthur directory, e.g. CubemapConvert images/lake writes images/lake/skybox.cube
+// Building the project runs it over the skyboxes Arthur offers (ConvertSkyboxes in CubemapConvert.vcxproj), and
+// the solution builds it before Arthur
+
+// ================================
+
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+// Image loading Libs
+#include <SOIL.h>
+
+#include "../../Arthur/CubemapFile.h"
+
+int main(int argc, char** argv)
+{
+    std::string folder;
+    std::string output;
+    bool compress = true;
+    bool mipmapped = true;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (std::strcmp(argv[i], "-rgb8") == 0)
+            compress = false;
+        else if (std::strcmp(argv[i], "-nomips") == 0)
+            mipmapped = false;
+        else if (folder.empty())
+            folder = argv[i];
+        else
+            output = argv[i];
+    }
+    if (folder.empty())
+    {
+        std::cerr << "Usage: CubemapConvert <skybox folder> [output] [-rgb8] [-nomips]" << std::endl;
+        return 1;
+    }
+    if (output.empty())
+        output = folder + "/skybox.cube";
+
+    std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+
+    // Same face order as Skybox::configureSkybox
+    const char* names[6] = { "right", "left", "top", "bottom", "back", "front" };
+    unsigned char* faces[6] = { 0, 0, 0, 0, 0, 0 };
+    int size = 0;
+    bool valid = true;
+    for (int i = 0; i < 6 && valid; ++i)
+    {
+        std::string path = folder + "/" + names[i] + ".jpg";
+        int width, height;
+        faces[i] = SOIL_load_image(path.c_str(), &width, &height, 0, SOIL_LOAD_RGB);
+        if (!faces[i])
+        {
+            std::cerr << "ERROR::CUBEMAPCONVERT::FAILED_LOADING " << path << std::endl;
+            valid = false;
+        }
+        else if (width != height || (size != 0 && width != size))
+        {
+            std::cerr << "ERROR::CUBEMAPCONVERT::FACES_NOT_SQUARE_OR_MISMATCHED " << path << std::endl;
+            valid = false;
+        }
+        size = width;
+    }
+
+    CubemapFile cubemap;
+    if (valid)
+        cubemap.setFaces(size, faces, mipmapped);
+    for (int i = 0; i < 6; ++i)
+    {
+        if (faces[i])
+            SOIL_free_image_data(faces[i]);
+    }
+    if (!valid)
+        return 1;
+
+    // the faces are 8 bit JPGs, so BC1 is the block format that fits; BC6H is only for HDR sources
+    if (compress)
+        cubemap.compressBC1();
+
+    if (!cubemap.write(output))
+    {
+        std::cerr << "ERROR::CUBEMAPCONVERT::FAILED_WRITING " << output << std::endl;
+        return 1;
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+    std::cout << "Wrote " << size << "x" << size << " cubemap (" << cubemap.levels << " mips, " << (compress ? "BC1" : "RGB8") << ", "
+              << cubemap.data.size() / (1024 * 1024) << " MB) to " << output << " in " << seconds << "s" << std::endl;
+    return 0;
+}